@@ -17,25 +17,19 @@ struct Date {
       : month(6), date(1) {}
   Date(const int& m, const int& d)
       : month(m), date(d) {}
-  Date(const string& s) {
-    int pos = s.find('-');
-    month = stoi(s.substr(0, pos));
-    date = stoi(s.substr(pos + 1));
+  Date(string_view s) {
+    size_t pos = s.find('-');
+    month = ParseInt(s.substr(0, pos));
+    date = ParseInt(s.substr(pos + 1));
   }
-  Date(const Date& d)
-      : month(d.month), date(d.date) {}
+  // 平凡拷贝，才能放进Command的union里
+  Date(const Date& d) = default;
   ~Date() = default;
-  Date& operator=(const Date& d) {
-    if (this != &d) {
-      month = d.month;
-      date = d.date;
-    }
-    return *this;
-  }
-  Date& operator=(const string& s) {
-    int pos = s.find('-');
-    month = stoi(s.substr(0, pos));
-    date = stoi(s.substr(pos + 1));
+  Date& operator=(const Date& d) = default;
+  Date& operator=(string_view s) {
+    size_t pos = s.find('-');
+    month = ParseInt(s.substr(0, pos));
+    date = ParseInt(s.substr(pos + 1));
     return *this;
   }
   bool operator==(const Date& d) const {
@@ -104,8 +98,15 @@ struct Date {
     }
     return ret;
   }
-  friend std::ostream& operator<<(std::ostream& os, const Date& d) {
-    os << d.month / 10 << d.month % 10 << '-' << d.date / 10 << d.date % 10;
+  // 查表输出 MM-DD
+  void Print(char* p) const {
+    p[0] = Digits2[month * 2], p[1] = Digits2[month * 2 + 1];
+    p[2] = '-';
+    p[3] = Digits2[date * 2], p[4] = Digits2[date * 2 + 1];
+  }
+  friend Writer& operator<<(Writer& os, const Date& d) {
+    d.Print(os.reserve(5));
+    os.commit(5);
     return os;
   }
 };
@@ -118,10 +119,10 @@ struct Time {
       : hour(0), minute(0), days(0) {}
   Time(const int& h, const int& m)
       : hour(h), minute(m), days(0) {}
-  Time(const string& s) {
-    int pos = s.find(':');
-    hour = stoi(s.substr(0, pos));
-    minute = stoi(s.substr(pos + 1));
+  Time(string_view s) {
+    size_t pos = s.find(':');
+    hour = ParseInt(s.substr(0, pos));
+    minute = ParseInt(s.substr(pos + 1));
     days = 0;
   }
   Time(const Time& t)
@@ -136,10 +137,10 @@ struct Time {
     }
     return *this;
   }
-  Time& operator=(const string& s) {
-    int pos = s.find(':');
-    hour = stoi(s.substr(0, pos));
-    minute = stoi(s.substr(pos + 1));
+  Time& operator=(string_view s) {
+    size_t pos = s.find(':');
+    hour = ParseInt(s.substr(0, pos));
+    minute = ParseInt(s.substr(pos + 1));
     days = 0;
     return *this;
   }
@@ -200,8 +201,15 @@ struct Time {
     }
     return ret;
   }
-  friend std::ostream& operator<<(std::ostream& os, const Time& t) {
-    os << t.hour / 10 << t.hour % 10 << ':' << t.minute / 10 << t.minute % 10;
+  // 查表输出 HH:MM
+  void Print(char* p) const {
+    p[0] = Digits2[hour * 2], p[1] = Digits2[hour * 2 + 1];
+    p[2] = ':';
+    p[3] = Digits2[minute * 2], p[4] = Digits2[minute * 2 + 1];
+  }
+  friend Writer& operator<<(Writer& os, const Time& t) {
+    t.Print(os.reserve(5));
+    os.commit(5);
     return os;
   }
 };
@@ -221,13 +229,13 @@ struct DateTime {
   }
   DateTime(const DateTime& dt)
       : date(dt.date), time(dt.time) {}
-  DateTime(const string& d, const string& t)
+  DateTime(string_view d, string_view t)
       : date(d), time(t) {
     date += time.days;
     time.days = 0;
   }
-  DateTime(const string& dt) {
-    int pos = dt.find(' ');
+  DateTime(string_view dt) {
+    size_t pos = dt.find(' ');
     date = dt.substr(0, pos);
     time = dt.substr(pos + 1);
     date += time.days;
@@ -240,8 +248,8 @@ struct DateTime {
     }
     return *this;
   }
-  DateTime& operator=(const string& dt) {
-    int pos = dt.find(' ');
+  DateTime& operator=(string_view dt) {
+    size_t pos = dt.find(' ');
     date = dt.substr(0, pos);
     time = dt.substr(pos + 1);
     date += time.days;
@@ -295,8 +303,13 @@ struct DateTime {
       t *= -1;
     return d + t;
   }
-  friend std::ostream& operator<<(std::ostream& os, const DateTime& dt) {
-    os << dt.date << ' ' << dt.time;
+  // MM-DD HH:MM 一次写11个字节
+  friend Writer& operator<<(Writer& os, const DateTime& dt) {
+    char* p = os.reserve(11);
+    dt.date.Print(p);
+    p[5] = ' ';
+    dt.time.Print(p + 6);
+    os.commit(11);
     return os;
   }
 };
@@ -0,0 +1,307 @@
+#ifndef SJTU_TICKETSYSTEM_EXECUTOR_HPP
+#define SJTU_TICKETSYSTEM_EXECUTOR_HPP
+
+#include "Parser.hpp"
+#include "Protocol.hpp"
+#include "TicketSystem.hpp"
+#include "slowlog.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+namespace sjtu {
+
+/*
+执行器：拿到解析好的Command，调对应系统的接口
+* 输出全部写进wout，由调用者决定什么时候flush
+* 二进制请求的回复也是一帧：先写帧头和时间戳，处理函数按行写记录，最后回填负载长度
+* 不碰输入，可以脱离main单独喂Command
+* 按CommandType查处理函数表分发，指令名到CommandType的完美哈希在Parser.hpp里
+* 每条指令的执行时间记进这类指令的延迟直方图，stats指令输出
+* 执行期间的文件读写记在这类指令名下（见file.hpp），io_stats指令输出
+* 设置了慢日志时按阶段计时，超过阈值的指令把原文、总时间和各阶段时间交给慢日志
+* 编译时定义了TICKET_TRACE的话，每条指令是一个trace区间，名字是指令名，参数是时间戳
+*/
+class Executor {
+ private:
+  TicketSystem& KS;
+  UserSystem& US;
+  TrainSystem& TS;
+
+  LatencyHistogram latency[CMD_UNKNOWN + 1];  // 下标是CommandType，单位纳秒
+  SlowLog* slowLog = nullptr;
+
+  /*
+  慢日志的一行JSON，时间单位纳秒：
+  {"command":"[12] query_transfer -s A -t B -d 07-01","total_ns":..,"phases_ns":{"other":..,"index":..,...}}
+  */
+  void LogSlow(const Command& cmd, uint64_t elapsed) {
+    thread_local Writer text(nullptr), line(nullptr);
+    text.clear(), line.clear();
+    FormatRequest(cmd, text);
+    line << "{\"command\":\"";
+    for (size_t i = 0; i < text.size(); ++i) {
+      char c = text.data()[i];
+      if (c == '\n')
+        continue;
+      if (c == '"' || c == '\\')
+        line << '\\';
+      line << c;
+    }
+    line << "\",\"total_ns\":" << static_cast<long long>(elapsed) << ",\"phases_ns\":{";
+    for (int p = 0; p < PHASE_COUNT; ++p)
+      line << (p ? ",\"" : "\"") << PhaseNames[p] << "\":" << static_cast<long long>(phaseClock.total[p]);
+    line << "}}\n";
+    slowLog->Append(line.data(), line.size());
+  }
+
+  // 处理函数，返回false表示收到exit
+  using Handler = bool (Executor::*)(const Command&);
+
+  bool AddUser(const Command& cmd) {
+    const AddUserArgs& a = cmd.addUser;
+    US.AddUser(a.cur, a.user, a.password, a.name, a.mail, a.privilege);
+    return true;
+  }
+  bool Login(const Command& cmd) {
+    US.Login(cmd.login.user, cmd.login.password);
+    return true;
+  }
+  bool Logout(const Command& cmd) {
+    US.Logout(cmd.user.user);
+    return true;
+  }
+  bool QueryProfile(const Command& cmd) {
+    US.QueryProfile(cmd.queryProfile.cur, cmd.queryProfile.user);
+    return true;
+  }
+  bool ModifyProfile(const Command& cmd) {
+    const ModifyProfileArgs& a = cmd.modifyProfile;
+    US.ModifyProfile(a.cur, a.user, a.password, a.name, a.mail, a.privilege);
+    return true;
+  }
+  bool AddTrain(const Command& cmd) {
+    const AddTrainArgs& a = cmd.addTrain;
+    TS.AddTrain(a.trainID, a.stationNum, a.seatNum, a.stations, a.prices, a.startTime, a.travelTimes, a.stopoverTimes, a.saleDate, a.type);
+    return true;
+  }
+  bool DeleteTrain(const Command& cmd) {
+    TS.DeleteTrain(cmd.train.trainID);
+    return true;
+  }
+  bool ReleaseTrain(const Command& cmd) {
+    TS.ReleaseTrain(cmd.train.trainID);
+    return true;
+  }
+  bool QueryTrain(const Command& cmd) {
+    TS.QueryTrain(cmd.queryTrain.trainID, cmd.queryTrain.date);
+    return true;
+  }
+  bool QueryTicket(const Command& cmd) {
+    const QueryTicketArgs& a = cmd.queryTicket;
+    KS.QueryTicket(a.from, a.to, a.date, a.type, a.limit);
+    return true;
+  }
+  bool QueryTransfer(const Command& cmd) {
+    const QueryTicketArgs& a = cmd.queryTicket;
+    KS.QueryTransfer(a.from, a.to, a.date, a.type);
+    return true;
+  }
+  bool BuyTicket(const Command& cmd) {
+    const BuyTicketArgs& a = cmd.buyTicket;
+    KS.BuyTicket(a.user, a.trainID, a.date, a.from, a.to, a.num, a.queue);
+    return true;
+  }
+  bool QueryOrder(const Command& cmd) {
+    const QueryOrderArgs& a = cmd.queryOrder;
+    KS.QueryOrder(a.user, a.limit, a.offset, a.status, a.begin, a.end);
+    return true;
+  }
+  bool RefundTicket(const Command& cmd) {
+    KS.RefundTicket(cmd.refundTicket.user, cmd.refundTicket.num);
+    return true;
+  }
+  bool Clear(const Command&) {
+    US.Clear();
+    TS.Clear();
+    KS.Clear();
+    return true;
+  }
+  bool Exit(const Command&) {
+    ReplyText("bye");
+    return false;
+  }
+  /*
+  各类指令的延迟统计
+  * 第一行是有记录的指令种类数，之后每类一行：指令名 次数 p50 p90 p99 max，单位纳秒
+  * -r true 输出之后清零；这条stats自己在输出之后才记进去
+  */
+  bool Stats(const Command& cmd) {
+    int kinds = 0;
+    for (int k = 0; k <= CMD_UNKNOWN; ++k)
+      if (latency[k].Count())
+        ++kinds;
+    ReplyInt(kinds);
+    for (int k = 0; k <= CMD_UNKNOWN; ++k) {
+      const LatencyHistogram& h = latency[k];
+      uint64_t count = h.Count();
+      if (!count)
+        continue;
+      ReplyStat(k < CMD_UNKNOWN ? CommandNames[k] : "unknown", count, h.Percentile(0.5), h.Percentile(0.9), h.Percentile(0.99), h.Max());
+    }
+    if (cmd.stats.reset)
+      for (int k = 0; k <= CMD_UNKNOWN; ++k)
+        latency[k].Reset();
+    return true;
+  }
+  static string_view IoCommandName(int k) {
+    if (k < CMD_UNKNOWN)
+      return CommandNames[k];
+    return k == CMD_UNKNOWN ? "unknown" : "idle";
+  }
+  /*
+  各个文件按指令分的I/O计数
+  * 第一行是行数，之后每个(文件, 指令)一行JSON，没有读写的不输出
+  * idle是不在执行指令时的读写，比如启动时读文件头、退出时落盘
+  * -r true 输出之后清零
+  */
+  bool IoStats(const Command& cmd) {
+    int rows = 0;
+    openFiles.ForEach([&](File& f) {
+      for (int k = 0; k < IoSlots; ++k)
+        if (!f.Counter(k).Empty())
+          ++rows;
+    });
+    ReplyInt(rows);
+    openFiles.ForEach([&](File& f) {
+      for (int k = 0; k < IoSlots; ++k) {
+        const IoCounter& c = f.Counter(k);
+        if (c.Empty())
+          continue;
+        ReplyIo(f.Name(), IoCommandName(k), c.reads, c.writes, c.readBytes, c.writeBytes, c.seeks);
+      }
+      if (cmd.stats.reset)
+        f.ResetCounters();
+    });
+    return true;
+  }
+  // 把trace导出到启动时指定的文件，回导出的区间数；没编进trace或没指定文件回-1
+  bool TraceDump(const Command&) {
+    ReplyInt(tracePath ? ExportTrace(tracePath) : -1);
+    return true;
+  }
+  // 不认识的指令或者参数写坏了：回-1并在stderr说明，不再直接terminate
+  bool Unknown(const Command& cmd) {
+    ReplyInt(-1);
+    fprintf(stderr, "unknown or malformed command: %.*s\n", static_cast<int>(cmd.name.size()), cmd.name.data());
+    return true;
+  }
+
+  // 下标是CommandType，顺序必须和枚举一致
+  static_assert(CMD_UNKNOWN < IoIdle, "I/O计数的槽位不够");
+
+  static constexpr Handler Handlers[CMD_UNKNOWN + 1] = {
+      &Executor::AddUser,
+      &Executor::Login,
+      &Executor::Logout,
+      &Executor::QueryProfile,
+      &Executor::ModifyProfile,
+      &Executor::AddTrain,
+      &Executor::DeleteTrain,
+      &Executor::ReleaseTrain,
+      &Executor::QueryTrain,
+      &Executor::QueryTicket,
+      &Executor::QueryTransfer,
+      &Executor::BuyTicket,
+      &Executor::QueryOrder,
+      &Executor::RefundTicket,
+      &Executor::Clear,
+      &Executor::Exit,
+      &Executor::Stats,
+      &Executor::IoStats,
+      &Executor::TraceDump,
+      &Executor::Unknown,
+  };
+
+ public:
+  explicit Executor(TicketSystem& ks)
+      : KS(ks), US(ks.US), TS(ks.TS) {}
+
+  // 之后执行的指令超过阈值就记进log，nullptr关掉
+  void SetSlowLog(SlowLog* log) {
+    slowLog = log;
+  }
+
+  /*
+  延迟结算模式下，这条指令执行之前要不要先结算攒下的候补（见TicketSystem::SettleWaitlists）
+  * 只有退票不触发，所以一串连续的退票只结算一次，其他指令看到的总是结算完的状态
+  * 必须在按顺序分发指令的线程上、这条指令被执行（或丢给线程池）之前调用
+  */
+  bool NeedSettle(CommandType type) const {
+    return type != CMD_REFUND_TICKET && KS.Unsettled();
+  }
+  // 结算的I/O记在refund_ticket名下
+  void Settle() {
+    TRACE_SPAN("settle");
+    int outer = ioCommand;
+    ioCommand = CMD_REFUND_TICKET;
+    KS.SettleWaitlists();
+    ioCommand = outer;
+  }
+
+  // 时间戳的数值，trace里标记是哪条指令
+  static long long StampOf(const Command& cmd) {
+    if (cmd.binary)
+      return cmd.stamp;
+    long long v = 0;
+    for (char c : cmd.timestamp)
+      if (c >= '0' && c <= '9')
+        v = v * 10 + (c - '0');
+    return v;
+  }
+
+  // 返回false表示收到exit
+  bool Execute(const Command& cmd) {
+    TRACE_SPAN(cmd.type < CMD_UNKNOWN ? CommandNames[cmd.type].data() : "unknown", StampOf(cmd));
+    SlowLog* log = slowLog;
+    if (log)
+      phaseClock.Start();
+    uint64_t start = NowNanos();
+    int outer = ioCommand;
+    ioCommand = cmd.type;
+    bool running;
+    if (!cmd.binary && !cmd.rows) {
+      wout << cmd.timestamp << ' ';
+      running = (this->*Handlers[cmd.type])(cmd);
+    } else if (!cmd.binary) {
+      size_t at = BeginRowReply(wout, cmd.timestamp);
+      binaryReply = true;
+      running = (this->*Handlers[cmd.type])(cmd);
+      binaryReply = false;
+      EndRowReply(wout, at);
+    } else {
+      size_t at = wout.size();
+      Put8(wout, ReplyMagic);
+      Put8(wout, cmd.type);
+      Put32(wout, 0);
+      Put32(wout, cmd.stamp);
+      binaryReply = true;
+      running = (this->*Handlers[cmd.type])(cmd);
+      binaryReply = false;
+      Patch32(wout.data() + at + 2, wout.size() - at - FrameHeader);
+    }
+    arena.Reset();  // 这条指令的临时数组都已经析构了
+    ioCommand = outer;
+    uint64_t elapsed = NowNanos() - start;
+    latency[cmd.type].Record(elapsed);
+    if (log) {
+      phaseClock.Stop();
+      if (elapsed >= log->Threshold())
+        LogSlow(cmd, elapsed);
+    }
+    return running;
+  }
+};
+
+}  // namespace sjtu
+
+#endif  // !SJTU_TICKETSYSTEM_EXECUTOR_HPP
@@ -0,0 +1,592 @@
+#ifndef SJTU_TICKETSYSTEM_PARSER_HPP
+#define SJTU_TICKETSYSTEM_PARSER_HPP
+
+#include <unistd.h>
+
+#include "TicketSystem.hpp"
+#include "utils.hpp"
+
+namespace sjtu {
+
+/*
+按行读入，一次read一大块，行是缓冲区上的视图
+* 视图在下一次NextLine之前有效
+* 半行留到下次，缓冲区不够就倍增
+*/
+class LineReader {
+ private:
+  int fd;
+  char* buf;
+  size_t cap;
+  size_t beg = 0, end = 0;  // 未消费的数据 [beg,end)
+  bool eof = false;
+
+ public:
+  explicit LineReader(int fd_ = 0, size_t cap_ = 1 << 20)
+      : fd(fd_), cap(cap_) {
+    buf = static_cast<char*>(malloc(cap));
+  }
+  LineReader(const LineReader&) = delete;
+  LineReader& operator=(const LineReader&) = delete;
+  ~LineReader() {
+    free(buf);
+  }
+
+  bool NextLine(string_view& line) {
+    while (true) {
+      char* p = static_cast<char*>(memchr(buf + beg, '\n', end - beg));
+      if (p) {
+        size_t len = p - (buf + beg);
+        if (len && buf[beg + len - 1] == '\r')
+          --len;
+        line = string_view(buf + beg, len);
+        beg = p - buf + 1;
+        return true;
+      }
+      if (eof) {
+        if (beg == end)
+          return false;
+        line = string_view(buf + beg, end - beg);  // 最后一行没有换行符
+        beg = end;
+        return true;
+      }
+      // 把半行挪到开头再读
+      if (beg) {
+        memmove(buf, buf + beg, end - beg);
+        end -= beg;
+        beg = 0;
+      }
+      if (end == cap) {
+        cap <<= 1;
+        buf = static_cast<char*>(realloc(buf, cap));
+      }
+      ssize_t n = read(fd, buf + end, cap - end);
+      if (n <= 0)
+        eof = true;
+      else
+        end += n;
+    }
+  }
+};
+
+enum CommandType {
+  CMD_ADD_USER = 0,
+  CMD_LOGIN,
+  CMD_LOGOUT,
+  CMD_QUERY_PROFILE,
+  CMD_MODIFY_PROFILE,
+  CMD_ADD_TRAIN,
+  CMD_DELETE_TRAIN,
+  CMD_RELEASE_TRAIN,
+  CMD_QUERY_TRAIN,
+  CMD_QUERY_TICKET,
+  CMD_QUERY_TRANSFER,
+  CMD_BUY_TICKET,
+  CMD_QUERY_ORDER,
+  CMD_REFUND_TICKET,
+  CMD_CLEAR,
+  CMD_EXIT,
+  CMD_STATS,
+  CMD_IO_STATS,
+  CMD_TRACE_DUMP,
+  CMD_UNKNOWN  // 同时也是指令总数
+};
+
+// 每条指令一个参数结构体，字符串都是输入行（或二进制帧）上的视图，日期解析成Date
+struct AddUserArgs {
+  string_view cur, user, password, name, mail;
+  int privilege;
+};
+struct LoginArgs {
+  string_view user, password;
+};
+struct UserArgs {  // logout
+  string_view user;
+};
+struct QueryOrderArgs {
+  string_view user;
+  int limit;        // 最多输出几条，-1表示不限
+  int offset;       // 跳过最新的几条（过滤之后数）
+  int status;       // 只要这个状态的订单，-1表示不限，BadStatus表示给的状态认不出来
+  Date begin, end;  // 出发日期在 [begin, end] 里的订单，默认全年
+};
+struct QueryProfileArgs {
+  string_view cur, user;
+};
+struct ModifyProfileArgs {
+  string_view cur, user, password, name, mail;
+  int privilege;  // -1表示不修改
+};
+struct AddTrainArgs {
+  string_view trainID, stations, prices, startTime, travelTimes, stopoverTimes, saleDate;
+  int stationNum, seatNum;
+  char type;
+};
+struct TrainArgs {  // delete_train, release_train
+  string_view trainID;
+};
+struct QueryTrainArgs {
+  string_view trainID;
+  Date date;
+};
+struct QueryTicketArgs {  // query_ticket, query_transfer
+  string_view from, to;
+  Date date;
+  SortType type;
+  int limit;  // query_ticket只要最优的几个，-1表示不限
+};
+struct BuyTicketArgs {
+  string_view user, trainID, from, to;
+  Date date;
+  int num;
+  bool queue;
+};
+struct RefundTicketArgs {
+  string_view user;
+  int num;
+};
+struct StatsArgs {  // stats和io_stats共用
+  bool reset;       // 输出之后清零
+};
+
+// 解析好的一条指令
+struct Command {
+  string_view timestamp;  // 带方括号，原样输出；二进制请求没有
+  string_view name;
+  CommandType type;
+  unsigned stamp = 0;   // 二进制请求的时间戳
+  bool binary = false;  // 来自二进制帧，回复也用二进制
+  bool rows = false;    // 文本请求，但回复先写成结构化的行，由Pipeline的写线程转成文本（见FormatRowReply）
+  union {
+    AddUserArgs addUser;
+    LoginArgs login;
+    UserArgs user;
+    QueryOrderArgs queryOrder;
+    QueryProfileArgs queryProfile;
+    ModifyProfileArgs modifyProfile;
+    AddTrainArgs addTrain;
+    TrainArgs train;
+    QueryTrainArgs queryTrain;
+    QueryTicketArgs queryTicket;
+    BuyTicketArgs buyTicket;
+    RefundTicketArgs refundTicket;
+    StatsArgs stats;
+  };
+  Command()
+      : type(CMD_UNKNOWN), user() {}
+};
+
+const int MaxTokens = 32;
+
+// 按空格切分，返回token数
+int Tokenize(string_view line, string_view* tok) {
+  int n = 0;
+  size_t i = 0, len = line.size();
+  while (i < len && n < MaxTokens) {
+    while (i < len && line[i] == ' ')
+      ++i;
+    if (i == len)
+      break;
+    size_t j = i;
+    while (j < len && line[j] != ' ')
+      ++j;
+    tok[n++] = line.substr(i, j - i);
+    i = j;
+  }
+  return n;
+}
+
+// 指令名表，下标就是CommandType
+constexpr string_view CommandNames[CMD_UNKNOWN] = {
+    "add_user",
+    "login",
+    "logout",
+    "query_profile",
+    "modify_profile",
+    "add_train",
+    "delete_train",
+    "release_train",
+    "query_train",
+    "query_ticket",
+    "query_transfer",
+    "buy_ticket",
+    "query_order",
+    "refund_ticket",
+    "clear",
+    "exit",
+    "stats",
+    "io_stats",
+    "trace_dump",
+};
+
+/*
+指令名的完美哈希
+* 带种子的FNV-1a，编译期从1开始试种子，直到所有指令名落在不同的槽里
+* 查询时算一次哈希、比较一次字符串，和指令在表里的顺序无关
+* 加新指令只要往CommandType和CommandNames里加，种子会自动重新找
+*/
+const int CommandSlots = 64;  // 2的幂，取模用&
+constexpr unsigned HashCommand(string_view s, unsigned seed) {
+  unsigned h = 2166136261u ^ seed;
+  for (size_t i = 0; i < s.size(); ++i) {
+    h ^= static_cast<unsigned char>(s[i]);
+    h *= 16777619u;
+  }
+  return h;
+}
+constexpr bool SeedWorks(unsigned seed) {
+  bool used[CommandSlots] = {};
+  for (int i = 0; i < CMD_UNKNOWN; ++i) {
+    unsigned slot = HashCommand(CommandNames[i], seed) & (CommandSlots - 1);
+    if (used[slot])
+      return false;
+    used[slot] = true;
+  }
+  return true;
+}
+constexpr unsigned FindCommandSeed() {
+  unsigned seed = 1;
+  while (!SeedWorks(seed))
+    ++seed;
+  return seed;
+}
+constexpr unsigned CommandSeed = FindCommandSeed();
+
+struct CommandTable {
+  CommandType slot[CommandSlots];
+};
+constexpr CommandTable BuildCommandTable() {
+  CommandTable t = {};
+  for (int i = 0; i < CommandSlots; ++i)
+    t.slot[i] = CMD_UNKNOWN;
+  for (int i = 0; i < CMD_UNKNOWN; ++i)
+    t.slot[HashCommand(CommandNames[i], CommandSeed) & (CommandSlots - 1)] = static_cast<CommandType>(i);
+  return t;
+}
+constexpr CommandTable CommandLookup = BuildCommandTable();
+
+CommandType CommandOf(string_view name) {
+  CommandType t = CommandLookup.slot[HashCommand(name, CommandSeed) & (CommandSlots - 1)];
+  if (t != CMD_UNKNOWN && CommandNames[t] == name)
+    return t;
+  return CMD_UNKNOWN;
+}
+
+// query_order -s 的取值，认不出来返回BadStatus
+int StatusOf(string_view s) {
+  if (s == "success")
+    return SUCCESS;
+  if (s == "pending")
+    return QUEUE;
+  if (s == "refunded")
+    return REFUNDED;
+  return BadStatus;
+}
+
+/*
+解析一行
+* 参数按 -x value 成对出现，用x直接switch分发（26个字母本身就是完美哈希）
+* 参数名不是 -x 的样子（比如单独一个'-'），或者最后一个参数名没有值时，整行当作不认识的指令，执行时回-1
+* 整数直接在视图上解析，不产生新的string
+return: 空行返回false
+*/
+bool ParseCommand(string_view line, Command& cmd) {
+  string_view tok[MaxTokens];
+  int n = Tokenize(line, tok);
+  if (n < 2)
+    return false;
+  cmd.timestamp = tok[0];
+  cmd.name = tok[1];
+  cmd.type = CommandOf(tok[1]);
+  for (int i = 2; i < n; i += 2)
+    if (i + 1 == n || tok[i].size() != 2 || tok[i][0] != '-') {
+      cmd.type = CMD_UNKNOWN;
+      return true;
+    }
+  switch (cmd.type) {
+    case CMD_ADD_USER: {
+      AddUserArgs& a = cmd.addUser;
+      a = AddUserArgs();
+      a.privilege = 0;
+      for (int i = 2; i + 1 < n; i += 2) {
+        switch (tok[i][1]) {
+          case 'c':
+            a.cur = tok[i + 1];
+            break;
+          case 'u':
+            a.user = tok[i + 1];
+            break;
+          case 'p':
+            a.password = tok[i + 1];
+            break;
+          case 'n':
+            a.name = tok[i + 1];
+            break;
+          case 'm':
+            a.mail = tok[i + 1];
+            break;
+          case 'g':
+            a.privilege = ParseInt(tok[i + 1]);
+            break;
+        }
+      }
+      break;
+    }
+    case CMD_LOGIN: {
+      LoginArgs& a = cmd.login;
+      a = LoginArgs();
+      for (int i = 2; i + 1 < n; i += 2) {
+        switch (tok[i][1]) {
+          case 'u':
+            a.user = tok[i + 1];
+            break;
+          case 'p':
+            a.password = tok[i + 1];
+            break;
+        }
+      }
+      break;
+    }
+    case CMD_LOGOUT: {
+      UserArgs& a = cmd.user;
+      a = UserArgs();
+      for (int i = 2; i + 1 < n; i += 2) {
+        if (tok[i][1] == 'u')
+          a.user = tok[i + 1];
+      }
+      break;
+    }
+    case CMD_QUERY_ORDER: {
+      QueryOrderArgs& a = cmd.queryOrder;
+      a = QueryOrderArgs();
+      a.limit = a.status = -1;
+      a.offset = 0;
+      a.begin = Date(1, 1), a.end = Date(12, 31);
+      for (int i = 2; i + 1 < n; i += 2) {
+        switch (tok[i][1]) {
+          case 'u':
+            a.user = tok[i + 1];
+            break;
+          case 'l':
+            a.limit = ParseInt(tok[i + 1]);
+            break;
+          case 'o':
+            a.offset = ParseInt(tok[i + 1]);
+            break;
+          case 's':
+            a.status = StatusOf(tok[i + 1]);
+            break;
+          case 'd': {
+            // 一个日期，或者 起|止
+            string_view v = tok[i + 1];
+            size_t bar = v.find('|');
+            a.begin = v.substr(0, bar);
+            a.end = bar == string_view::npos ? a.begin : Date(v.substr(bar + 1));
+            break;
+          }
+        }
+      }
+      break;
+    }
+    case CMD_QUERY_PROFILE: {
+      QueryProfileArgs& a = cmd.queryProfile;
+      a = QueryProfileArgs();
+      for (int i = 2; i + 1 < n; i += 2) {
+        switch (tok[i][1]) {
+          case 'c':
+            a.cur = tok[i + 1];
+            break;
+          case 'u':
+            a.user = tok[i + 1];
+            break;
+        }
+      }
+      break;
+    }
+    case CMD_MODIFY_PROFILE: {
+      ModifyProfileArgs& a = cmd.modifyProfile;
+      a = ModifyProfileArgs();
+      a.privilege = -1;
+      for (int i = 2; i + 1 < n; i += 2) {
+        switch (tok[i][1]) {
+          case 'c':
+            a.cur = tok[i + 1];
+            break;
+          case 'u':
+            a.user = tok[i + 1];
+            break;
+          case 'p':
+            a.password = tok[i + 1];
+            break;
+          case 'n':
+            a.name = tok[i + 1];
+            break;
+          case 'm':
+            a.mail = tok[i + 1];
+            break;
+          case 'g':
+            a.privilege = ParseInt(tok[i + 1]);
+            break;
+        }
+      }
+      break;
+    }
+    case CMD_ADD_TRAIN: {
+      AddTrainArgs& a = cmd.addTrain;
+      a = AddTrainArgs();
+      a.stationNum = a.seatNum = 0;
+      a.type = 0;
+      for (int i = 2; i + 1 < n; i += 2) {
+        switch (tok[i][1]) {
+          case 'i':
+            a.trainID = tok[i + 1];
+            break;
+          case 'n':
+            a.stationNum = ParseInt(tok[i + 1]);
+            break;
+          case 'm':
+            a.seatNum = ParseInt(tok[i + 1]);
+            break;
+          case 's':
+            a.stations = tok[i + 1];
+            break;
+          case 'p':
+            a.prices = tok[i + 1];
+            break;
+          case 'x':
+            a.startTime = tok[i + 1];
+            break;
+          case 't':
+            a.travelTimes = tok[i + 1];
+            break;
+          case 'o':
+            a.stopoverTimes = tok[i + 1];
+            break;
+          case 'd':
+            a.saleDate = tok[i + 1];
+            break;
+          case 'y':
+            a.type = tok[i + 1][0];
+            break;
+        }
+      }
+      break;
+    }
+    case CMD_DELETE_TRAIN:
+    case CMD_RELEASE_TRAIN: {
+      TrainArgs& a = cmd.train;
+      a = TrainArgs();
+      for (int i = 2; i + 1 < n; i += 2) {
+        if (tok[i][1] == 'i')
+          a.trainID = tok[i + 1];
+      }
+      break;
+    }
+    case CMD_QUERY_TRAIN: {
+      QueryTrainArgs& a = cmd.queryTrain;
+      a = QueryTrainArgs();
+      for (int i = 2; i + 1 < n; i += 2) {
+        switch (tok[i][1]) {
+          case 'i':
+            a.trainID = tok[i + 1];
+            break;
+          case 'd':
+            a.date = tok[i + 1];
+            break;
+        }
+      }
+      break;
+    }
+    case CMD_QUERY_TICKET:
+    case CMD_QUERY_TRANSFER: {
+      QueryTicketArgs& a = cmd.queryTicket;
+      a = QueryTicketArgs();
+      a.type = TIME;
+      a.limit = -1;
+      for (int i = 2; i + 1 < n; i += 2) {
+        switch (tok[i][1]) {
+          case 's':
+            a.from = tok[i + 1];
+            break;
+          case 't':
+            a.to = tok[i + 1];
+            break;
+          case 'd':
+            a.date = tok[i + 1];
+            break;
+          case 'p':
+            a.type = tok[i + 1] == "time" ? TIME : COST;
+            break;
+          case 'k':
+            a.limit = ParseInt(tok[i + 1]);
+            break;
+        }
+      }
+      break;
+    }
+    case CMD_BUY_TICKET: {
+      BuyTicketArgs& a = cmd.buyTicket;
+      a = BuyTicketArgs();
+      a.num = 0;
+      a.queue = false;
+      for (int i = 2; i + 1 < n; i += 2) {
+        switch (tok[i][1]) {
+          case 'u':
+            a.user = tok[i + 1];
+            break;
+          case 'i':
+            a.trainID = tok[i + 1];
+            break;
+          case 'd':
+            a.date = tok[i + 1];
+            break;
+          case 'n':
+            a.num = ParseInt(tok[i + 1]);
+            break;
+          case 'f':
+            a.from = tok[i + 1];
+            break;
+          case 't':
+            a.to = tok[i + 1];
+            break;
+          case 'q':
+            a.queue = tok[i + 1] == "true";
+            break;
+        }
+      }
+      break;
+    }
+    case CMD_REFUND_TICKET: {
+      RefundTicketArgs& a = cmd.refundTicket;
+      a = RefundTicketArgs();
+      a.num = 1;
+      for (int i = 2; i + 1 < n; i += 2) {
+        switch (tok[i][1]) {
+          case 'u':
+            a.user = tok[i + 1];
+            break;
+          case 'n':
+            a.num = ParseInt(tok[i + 1]);
+            break;
+        }
+      }
+      break;
+    }
+    case CMD_STATS:
+    case CMD_IO_STATS: {
+      cmd.stats.reset = false;
+      for (int i = 2; i + 1 < n; i += 2) {
+        if (tok[i][1] == 'r')
+          cmd.stats.reset = tok[i + 1] == "true";
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return true;
+}
+
+}  // namespace sjtu
+
+#endif  // !SJTU_TICKETSYSTEM_PARSER_HPP
@@ -0,0 +1,187 @@
+#ifndef SJTU_TICKETSYSTEM_PIPELINE_HPP
+#define SJTU_TICKETSYSTEM_PIPELINE_HPP
+
+#include <thread>
+
+#include "Executor.hpp"
+#include "Parser.hpp"
+#include "Scheduler.hpp"
+#include "spsc.hpp"
+
+namespace sjtu {
+
+// 单线程：读一行、执行一行、flush一行
+void RunSerial(int fd, Executor& executor) {
+  LineReader reader(fd);
+  Command cmd;
+  string_view line;
+  while (reader.NextLine(line)) {
+    if (!ParseCommand(line, cmd))
+      continue;  // 空行
+    if (executor.NeedSettle(cmd.type))
+      executor.Settle();
+    bool running = executor.Execute(cmd);
+    wout.flush();  // 一条指令flush一次
+    if (!running)
+      break;
+  }
+  wout.flush();
+}
+
+/*
+一批输入在流水线里流转的载体
+* input: 读进来的原始字节，cmds里的视图都指向这里
+* output: 执行完的输出，交给写线程；sink是它flush/析构时写到哪里，nullptr表示由调用者自己发送
+*/
+struct Batch {
+  char* input;
+  size_t len = 0;
+  size_t cap;
+  vector<Command> cmds;
+  Writer output;
+
+  explicit Batch(size_t cap_ = 1 << 20, FILE* sink = stdout)
+      : cap(cap_), output(sink) {
+    input = static_cast<char*>(malloc(cap));
+  }
+  Batch(const Batch&) = delete;
+  Batch& operator=(const Batch&) = delete;
+  ~Batch() {
+    free(input);
+  }
+  void Reserve(size_t need) {
+    if (len + need <= cap)
+      return;
+    while (cap < len + need)
+      cap <<= 1;
+    input = static_cast<char*>(realloc(input, cap));
+  }
+};
+
+/*
+把b->input里 [0,len) 完整的行解析进b->cmds，返回第一个未消费字节的位置
+* eof为true时最后没有换行的半行也算一行
+* 遇到exit就停，stop置true，exit之后的输入不再要
+*/
+size_t ParseLines(Batch* b, bool eof, bool& stop) {
+  size_t beg = 0;
+  Command cmd;
+  while (beg < b->len) {
+    char* p = static_cast<char*>(memchr(b->input + beg, '\n', b->len - beg));
+    if (!p && !eof)
+      break;  // 半行，留给下一批
+    size_t end = p ? p - b->input : b->len;
+    size_t len = end - beg;
+    if (len && b->input[beg + len - 1] == '\r')
+      --len;
+    if (ParseCommand(string_view(b->input + beg, len), cmd)) {
+      b->cmds.push_back(cmd);
+      if (cmd.type == CMD_EXIT) {
+        stop = true;
+        return b->len;
+      }
+    }
+    beg = p ? end + 1 : b->len;
+  }
+  return beg;
+}
+
+/*
+三段流水线
+* 读线程：read一大块，切行、解析成Command，整批交给执行线程
+* 执行线程（调用Run的线程）：交给Scheduler按序执行，回复只写成结构化的行（Command::rows），
+  攒在wout里，一批结束后换给写线程
+* 写线程：把这些行格式化成文本写到stdout，空出来的Batch还给读线程；数字、日期时间转文本的开销不在执行线程上
+* 三段之间都是有界SPSC队列，Batch总数固定，读得太快会被反压住
+* 只有一个执行线程、队列先进先出，所以输出顺序和输入（时间戳）顺序一致
+*/
+class Pipeline {
+ private:
+  static const int BatchCount = 8;
+  Batch batches[BatchCount];
+  SpscQueue<Batch*, 16> freeQueue;   // 写线程 -> 读线程
+  SpscQueue<Batch*, 16> execQueue;   // 读线程 -> 执行线程，nullptr表示输入结束
+  SpscQueue<Batch*, 16> writeQueue;  // 执行线程 -> 写线程，nullptr表示结束
+  int fd;
+
+  void ReadLoop() {
+    Writer carry(nullptr);  // 上一批剩下的半行
+    bool eof = false, stop = false;
+    while (!eof && !stop) {
+      Batch* b = freeQueue.Pop();
+      b->len = 0;
+      b->cmds.clear();
+      b->Reserve(carry.size());
+      memcpy(b->input, carry.data(), carry.size());
+      b->len = carry.size();
+      carry.clear();
+      // 至少读到一个完整的行（或者读完）才交出去
+      while (true) {
+        if (b->len == b->cap)
+          b->Reserve(b->cap);
+        ssize_t n = read(fd, b->input + b->len, b->cap - b->len);
+        if (n <= 0)
+          eof = true;
+        else
+          b->len += n;
+        if (eof || memchr(b->input + b->len - n, '\n', n))
+          break;
+      }
+      size_t used = ParseLines(b, eof, stop);
+      for (size_t i = 0; i < b->cmds.size(); ++i)
+        b->cmds[i].rows = true;
+      carry.write(b->input + used, b->len - used);
+      execQueue.Push(b);
+    }
+    execQueue.Push(nullptr);
+  }
+
+  void WriteLoop() {
+    Writer text(stdout);
+    while (Batch* b = writeQueue.Pop()) {
+      const char* p = b->output.data();
+      size_t n = b->output.size(), at = 0;
+      while (at < n) {
+        long used = FormatRowReply(p + at, n - at, text);
+        if (used < 0) {
+          fprintf(stderr, "pipeline: malformed reply record, dropping the rest of the batch\n");
+          break;
+        }
+        at += used;
+      }
+      b->output.clear();
+      text.flush();
+      fflush(stdout);
+      freeQueue.Push(b);
+    }
+  }
+
+ public:
+  explicit Pipeline(int fd_ = 0)
+      : fd(fd_) {}
+
+  void Run(Scheduler& scheduler) {
+    for (int i = 0; i < BatchCount; ++i)
+      freeQueue.Push(&batches[i]);
+    wout.flush();
+    std::thread reader(&Pipeline::ReadLoop, this);
+    std::thread writer(&Pipeline::WriteLoop, this);
+    bool running = true;
+    while (running) {
+      Batch* b = execQueue.Pop();
+      if (!b)
+        break;
+      if (!b->cmds.empty())
+        running = scheduler.Run(&b->cmds[0], b->cmds.size());
+      wout.swap(b->output);
+      writeQueue.Push(b);
+    }
+    writeQueue.Push(nullptr);
+    reader.join();  // 读线程看到exit或者EOF就会自己停
+    writer.join();
+  }
+};
+
+}  // namespace sjtu
+
+#endif  // !SJTU_TICKETSYSTEM_PIPELINE_HPP
@@ -0,0 +1,498 @@
+#ifndef SJTU_TICKETSYSTEM_PROTOCOL_HPP
+#define SJTU_TICKETSYSTEM_PROTOCOL_HPP
+
+#include "Parser.hpp"
+#include "reply.hpp"
+#include "wire.hpp"
+
+namespace sjtu {
+
+/*
+二进制请求/回复，帧格式见wire.hpp，回复的行格式见reply.hpp
+* 请求负载：时间戳之后按指令类型排好的定长字段，没有参数名
+*   用户名、车次、车站等是短字符串；日期是打包的2字节；排序方式、是否候补是1字节
+*   add_train的各个列表仍是'|'分隔的文本（长字符串），和Executor直接接上
+*   modify_profile里空串表示不改，privilege为-1表示不改
+*   query_ticket/query_transfer的limit、query_order的limit为-1表示不限，状态为255表示不限、254表示认不出来的状态，日期范围总是带上
+* 解码出来的Command里的字符串是帧上的视图
+* 另外提供和文本协议的互转，测试时可以拿文本用例对拍
+*/
+
+// 把一条指令编码成请求帧，时间戳取自cmd.stamp（二进制）或cmd.timestamp（文本）
+void EncodeRequest(const Command& cmd, Writer& out) {
+  size_t at = out.size();
+  Put8(out, RequestMagic);
+  Put8(out, cmd.type);
+  Put32(out, 0);
+  unsigned stamp = cmd.stamp;
+  if (!cmd.binary)
+    stamp = ParseInt(cmd.timestamp.substr(1, cmd.timestamp.size() - 2));
+  Put32(out, stamp);
+  switch (cmd.type) {
+    case CMD_ADD_USER: {
+      const AddUserArgs& a = cmd.addUser;
+      PutStr(out, a.cur), PutStr(out, a.user), PutStr(out, a.password), PutStr(out, a.name), PutStr(out, a.mail);
+      Put32(out, a.privilege);
+      break;
+    }
+    case CMD_LOGIN:
+      PutStr(out, cmd.login.user), PutStr(out, cmd.login.password);
+      break;
+    case CMD_LOGOUT:
+      PutStr(out, cmd.user.user);
+      break;
+    case CMD_QUERY_ORDER: {
+      const QueryOrderArgs& a = cmd.queryOrder;
+      PutStr(out, a.user);
+      Put32(out, a.limit), Put32(out, a.offset);
+      Put8(out, a.status == BadStatus ? 254 : a.status < 0 ? 255 : a.status);
+      Put16(out, PackDate(a.begin)), Put16(out, PackDate(a.end));
+      break;
+    }
+    case CMD_QUERY_PROFILE:
+      PutStr(out, cmd.queryProfile.cur), PutStr(out, cmd.queryProfile.user);
+      break;
+    case CMD_MODIFY_PROFILE: {
+      const ModifyProfileArgs& a = cmd.modifyProfile;
+      PutStr(out, a.cur), PutStr(out, a.user), PutStr(out, a.password), PutStr(out, a.name), PutStr(out, a.mail);
+      Put32(out, a.privilege);
+      break;
+    }
+    case CMD_ADD_TRAIN: {
+      const AddTrainArgs& a = cmd.addTrain;
+      PutStr(out, a.trainID);
+      Put32(out, a.stationNum), Put32(out, a.seatNum);
+      PutLongStr(out, a.stations), PutLongStr(out, a.prices);
+      PutStr(out, a.startTime);
+      PutLongStr(out, a.travelTimes), PutLongStr(out, a.stopoverTimes);
+      PutStr(out, a.saleDate);
+      Put8(out, a.type);
+      break;
+    }
+    case CMD_DELETE_TRAIN:
+    case CMD_RELEASE_TRAIN:
+      PutStr(out, cmd.train.trainID);
+      break;
+    case CMD_QUERY_TRAIN:
+      PutStr(out, cmd.queryTrain.trainID);
+      Put16(out, PackDate(cmd.queryTrain.date));
+      break;
+    case CMD_QUERY_TICKET:
+    case CMD_QUERY_TRANSFER: {
+      const QueryTicketArgs& a = cmd.queryTicket;
+      PutStr(out, a.from), PutStr(out, a.to);
+      Put16(out, PackDate(a.date));
+      Put8(out, a.type);
+      Put32(out, a.limit);
+      break;
+    }
+    case CMD_BUY_TICKET: {
+      const BuyTicketArgs& a = cmd.buyTicket;
+      PutStr(out, a.user), PutStr(out, a.trainID);
+      Put16(out, PackDate(a.date));
+      PutStr(out, a.from), PutStr(out, a.to);
+      Put32(out, a.num);
+      Put8(out, a.queue);
+      break;
+    }
+    case CMD_REFUND_TICKET:
+      PutStr(out, cmd.refundTicket.user);
+      Put32(out, cmd.refundTicket.num);
+      break;
+    case CMD_STATS:
+    case CMD_IO_STATS:
+      Put8(out, cmd.stats.reset);
+      break;
+    default:
+      break;
+  }
+  Patch32(out.data() + at + 2, out.size() - at - FrameHeader);
+}
+
+// 字符串字段最后要放进的定长类型的大小（含结尾'\0'），超长的帧直接当坏帧
+const size_t IdCap = sizeof(ID), WordCap = sizeof(Word), StationCap = sizeof(String);
+const int MaxStations = 100;  // Train里各数组的长度
+
+// '|'分隔的列表有几项
+inline int FieldCount(string_view s) {
+  int n = 1;
+  for (char c : s)
+    n += c == '|';
+  return n;
+}
+// 一个6-8月里的日期，Train的座位表只排了这几个月
+inline bool InSeason(const Date& d) {
+  return d.month >= 6 && d.month <= 8 && d.date >= 1 && d.date <= 31;
+}
+/*
+add_train的几个列表和stationNum对得上，AddTrain按stationNum直接取各项，不再检查
+* 车站stationNum项，票价和运行时间各stationNum-1项
+* 停站时间stationNum-2项，只有两站时是"_"
+* 发售日期两项，都在季内且不倒过来
+*/
+inline bool ValidTrainLists(const AddTrainArgs& a) {
+  int n = a.stationNum;
+  if (FieldCount(a.stations) != n || FieldCount(a.prices) != n - 1 || FieldCount(a.travelTimes) != n - 1)
+    return false;
+  if (n == 2 ? a.stopoverTimes != "_" : FieldCount(a.stopoverTimes) != n - 2)
+    return false;
+  if (FieldCount(a.saleDate) != 2)
+    return false;
+  size_t bar = a.saleDate.find('|');
+  Date begin(a.saleDate.substr(0, bar)), end(a.saleDate.substr(bar + 1));
+  return InSeason(begin) && InSeason(end) && begin <= end;
+}
+
+/*
+从p开始的n个字节里解一个请求帧
+return: 帧的总字节数；数据还不够一帧返回0；坏帧（magic、类型、长度、字段超长或取值不对）返回-1
+*/
+long DecodeRequest(const char* p, size_t n, Command& cmd) {
+  if (n < FrameHeader)
+    return 0;
+  unsigned char type = p[1];
+  uint32_t len = FrameLength(p);
+  if (static_cast<unsigned char>(p[0]) != RequestMagic || type >= CMD_UNKNOWN || len > MaxFrame)
+    return -1;
+  if (n < FrameHeader + len)
+    return 0;
+  WireReader r(p + FrameHeader, len);
+  cmd.binary = true;
+  cmd.timestamp = string_view();
+  cmd.type = static_cast<CommandType>(type);
+  cmd.name = CommandNames[type];
+  cmd.stamp = r.Get32();
+  switch (cmd.type) {
+    case CMD_ADD_USER: {
+      AddUserArgs& a = cmd.addUser;
+      a.cur = r.GetStr(IdCap), a.user = r.GetStr(IdCap), a.password = r.GetStr(WordCap), a.name = r.GetStr(WordCap), a.mail = r.GetStr(WordCap);
+      a.privilege = r.GetInt();
+      break;
+    }
+    case CMD_LOGIN:
+      cmd.login.user = r.GetStr(IdCap), cmd.login.password = r.GetStr(WordCap);
+      break;
+    case CMD_LOGOUT:
+      cmd.user.user = r.GetStr(IdCap);
+      break;
+    case CMD_QUERY_ORDER: {
+      QueryOrderArgs& a = cmd.queryOrder;
+      a.user = r.GetStr(IdCap);
+      a.limit = r.GetInt(), a.offset = r.GetInt();
+      unsigned status = r.Get8();
+      if (status > REFUNDED && status < 254)
+        r.ok = false;
+      a.status = status == 255 ? -1 : status == 254 ? BadStatus : static_cast<int>(status);
+      a.begin = r.GetDate(), a.end = r.GetDate();
+      break;
+    }
+    case CMD_QUERY_PROFILE:
+      cmd.queryProfile.cur = r.GetStr(IdCap), cmd.queryProfile.user = r.GetStr(IdCap);
+      break;
+    case CMD_MODIFY_PROFILE: {
+      ModifyProfileArgs& a = cmd.modifyProfile;
+      a.cur = r.GetStr(IdCap), a.user = r.GetStr(IdCap), a.password = r.GetStr(WordCap), a.name = r.GetStr(WordCap), a.mail = r.GetStr(WordCap);
+      a.privilege = r.GetInt();
+      break;
+    }
+    case CMD_ADD_TRAIN: {
+      AddTrainArgs& a = cmd.addTrain;
+      a.trainID = r.GetStr(IdCap);
+      a.stationNum = r.GetInt(), a.seatNum = r.GetInt();
+      if (a.stationNum < 2 || a.stationNum > MaxStations)
+        r.ok = false;
+      a.stations = r.GetLongStr(), a.prices = r.GetLongStr();
+      a.startTime = r.GetStr();
+      a.travelTimes = r.GetLongStr(), a.stopoverTimes = r.GetLongStr();
+      a.saleDate = r.GetStr();
+      a.type = r.Get8();
+      if (r.ok && !ValidTrainLists(a))
+        r.ok = false;
+      break;
+    }
+    case CMD_DELETE_TRAIN:
+    case CMD_RELEASE_TRAIN:
+      cmd.train.trainID = r.GetStr(IdCap);
+      break;
+    case CMD_QUERY_TRAIN:
+      cmd.queryTrain.trainID = r.GetStr(IdCap);
+      cmd.queryTrain.date = r.GetDate();
+      break;
+    case CMD_QUERY_TICKET:
+    case CMD_QUERY_TRANSFER: {
+      QueryTicketArgs& a = cmd.queryTicket;
+      a.from = r.GetStr(StationCap), a.to = r.GetStr(StationCap);
+      a.date = r.GetDate();
+      a.type = r.Get8() ? COST : TIME;
+      a.limit = r.GetInt();
+      break;
+    }
+    case CMD_BUY_TICKET: {
+      BuyTicketArgs& a = cmd.buyTicket;
+      a.user = r.GetStr(IdCap), a.trainID = r.GetStr(IdCap);
+      a.date = r.GetDate();
+      a.from = r.GetStr(StationCap), a.to = r.GetStr(StationCap);
+      a.num = r.GetInt();
+      a.queue = r.Get8();
+      break;
+    }
+    case CMD_REFUND_TICKET:
+      cmd.refundTicket.user = r.GetStr(IdCap);
+      cmd.refundTicket.num = r.GetInt();
+      break;
+    case CMD_STATS:
+    case CMD_IO_STATS:
+      cmd.stats.reset = r.Get8();
+      break;
+    default:
+      break;
+  }
+  if (!r.Done())
+    return -1;
+  return FrameHeader + len;
+}
+
+// 把一条指令写回文本协议的一行，参数顺序固定
+void FormatRequest(const Command& cmd, Writer& out) {
+  if (cmd.binary)
+    out << '[' << static_cast<long long>(cmd.stamp) << ']';
+  else
+    out << cmd.timestamp;
+  out << ' ' << cmd.name;
+  // 空串表示没有这个参数
+  auto arg = [&](char key, string_view v) {
+    if (!v.empty())
+      out << " -" << key << ' ' << v;
+  };
+  auto num = [&](char key, int v) {
+    out << " -" << key << ' ' << v;
+  };
+  auto date = [&](const Date& d) {
+    out << " -d " << d;
+  };
+  switch (cmd.type) {
+    case CMD_ADD_USER: {
+      const AddUserArgs& a = cmd.addUser;
+      arg('c', a.cur), arg('u', a.user), arg('p', a.password), arg('n', a.name), arg('m', a.mail);
+      num('g', a.privilege);
+      break;
+    }
+    case CMD_LOGIN:
+      arg('u', cmd.login.user), arg('p', cmd.login.password);
+      break;
+    case CMD_LOGOUT:
+      arg('u', cmd.user.user);
+      break;
+    case CMD_QUERY_ORDER: {
+      const QueryOrderArgs& a = cmd.queryOrder;
+      arg('u', a.user);
+      // 默认值不写，原来的指令转回去还是原样
+      if (a.limit != -1)
+        num('l', a.limit);
+      if (a.offset)
+        num('o', a.offset);
+      if (a.status >= 0)
+        arg('s', a.status == SUCCESS ? "success" : a.status == QUEUE ? "pending" : "refunded");
+      else if (a.status == BadStatus)
+        arg('s', "unknown");
+      if (a.begin != Date(1, 1) || a.end != Date(12, 31))
+        out << " -d " << a.begin << '|' << a.end;
+      break;
+    }
+    case CMD_QUERY_PROFILE:
+      arg('c', cmd.queryProfile.cur), arg('u', cmd.queryProfile.user);
+      break;
+    case CMD_MODIFY_PROFILE: {
+      const ModifyProfileArgs& a = cmd.modifyProfile;
+      arg('c', a.cur), arg('u', a.user), arg('p', a.password), arg('n', a.name), arg('m', a.mail);
+      if (a.privilege != -1)
+        num('g', a.privilege);
+      break;
+    }
+    case CMD_ADD_TRAIN: {
+      const AddTrainArgs& a = cmd.addTrain;
+      arg('i', a.trainID);
+      num('n', a.stationNum), num('m', a.seatNum);
+      arg('s', a.stations), arg('p', a.prices), arg('x', a.startTime);
+      arg('t', a.travelTimes), arg('o', a.stopoverTimes), arg('d', a.saleDate);
+      out << " -y " << a.type;
+      break;
+    }
+    case CMD_DELETE_TRAIN:
+    case CMD_RELEASE_TRAIN:
+      arg('i', cmd.train.trainID);
+      break;
+    case CMD_QUERY_TRAIN:
+      arg('i', cmd.queryTrain.trainID);
+      date(cmd.queryTrain.date);
+      break;
+    case CMD_QUERY_TICKET:
+    case CMD_QUERY_TRANSFER: {
+      const QueryTicketArgs& a = cmd.queryTicket;
+      arg('s', a.from), arg('t', a.to);
+      date(a.date);
+      arg('p', a.type == COST ? "cost" : "time");
+      if (a.limit != -1)
+        num('k', a.limit);
+      break;
+    }
+    case CMD_BUY_TICKET: {
+      const BuyTicketArgs& a = cmd.buyTicket;
+      arg('u', a.user), arg('i', a.trainID);
+      date(a.date);
+      num('n', a.num);
+      arg('f', a.from), arg('t', a.to), arg('q', a.queue ? "true" : "false");
+      break;
+    }
+    case CMD_REFUND_TICKET:
+      arg('u', cmd.refundTicket.user);
+      num('n', cmd.refundTicket.num);
+      break;
+    case CMD_STATS:
+    case CMD_IO_STATS:
+      if (cmd.stats.reset)
+        arg('r', "true");
+      break;
+    default:
+      break;
+  }
+  out << '\n';
+}
+
+/*
+把r里剩下的回复行（见reply.hpp）转成文本协议的输出
+return: 行都完整、合法；否则out里可能留下半行
+*/
+bool FormatReplyRows(WireReader& r, Writer& out) {
+  // 日期时间要合法才能安全地按表输出
+  auto dateTime = [&](DateTime& dt) {
+    uint32_t v = r.Get32();
+    if (v == NoDateTime)
+      return false;
+    int m = v >> 24, d = (v >> 16) & 0xFF;
+    if (m < 1 || m > 12 || d < 1 || d > MonthDays[m] || (v & 0xFFFF) >= 1440)
+      r.ok = false;
+    dt = r.ok ? UnpackDateTime(v) : DateTime();
+    return true;
+  };
+  while (r.ok && !r.Done()) {
+    unsigned kind = r.Get8();
+    switch (kind) {
+      case ROW_INT:
+        out << r.GetInt() << '\n';
+        break;
+      case ROW_TEXT:
+        out << r.GetStr() << '\n';
+        break;
+      case ROW_PROFILE: {
+        string_view id = r.GetStr(), name = r.GetStr(), mail = r.GetStr();
+        TextProfile(out, id, name, mail, r.GetInt());
+        break;
+      }
+      case ROW_TRAIN: {
+        string_view id = r.GetStr();
+        TextTrain(out, id, r.Get8());
+        break;
+      }
+      case ROW_STOP: {
+        string_view station = r.GetStr();
+        DateTime arrive, leave;
+        bool hasArrive = dateTime(arrive), hasLeave = dateTime(leave);
+        int price = r.GetInt();
+        TextStop(out, station, hasArrive ? &arrive : nullptr, hasLeave ? &leave : nullptr, price, r.GetInt());
+        break;
+      }
+      case ROW_TICKET:
+      case ROW_ORDER: {
+        unsigned status = kind == ROW_ORDER ? r.Get8() : 0;
+        if (status > 2)
+          r.ok = false;
+        string_view id = r.GetStr(), from = r.GetStr();
+        DateTime depart, arrive;
+        dateTime(depart);
+        string_view to = r.GetStr();
+        dateTime(arrive);
+        int price = r.GetInt(), seat = r.GetInt();
+        if (!r.ok)
+          break;
+        if (kind == ROW_ORDER)
+          out << OrderStatusText[status];
+        TextTicket(out, id, from, depart, to, arrive, price, seat);
+        break;
+      }
+      case ROW_STAT: {
+        string_view name = r.GetStr();
+        uint64_t count = r.Get64(), p50 = r.Get64(), p90 = r.Get64(), p99 = r.Get64(), max = r.Get64();
+        TextStat(out, name, count, p50, p90, p99, max);
+        break;
+      }
+      case ROW_IO: {
+        string_view file = r.GetStr(), command = r.GetStr();
+        uint64_t reads = r.Get64(), writes = r.Get64(), readBytes = r.Get64(), writeBytes = r.Get64(), seeks = r.Get64();
+        TextIo(out, file, command, reads, writes, readBytes, writeBytes, seeks);
+        break;
+      }
+      default:
+        r.ok = false;
+        break;
+    }
+  }
+  return r.ok;
+}
+
+/*
+把一个回复帧转成文本协议的输出，格式和文本请求得到的回复一致
+return: 同DecodeRequest；坏帧时out里可能留下半行
+*/
+long DecodeReply(const char* p, size_t n, Writer& out) {
+  if (n < FrameHeader)
+    return 0;
+  uint32_t len = FrameLength(p);
+  if (static_cast<unsigned char>(p[0]) != ReplyMagic || len > MaxFrame)
+    return -1;
+  if (n < FrameHeader + len)
+    return 0;
+  WireReader r(p + FrameHeader, len);
+  out << '[' << static_cast<long long>(r.Get32()) << "] ";
+  if (!FormatReplyRows(r, out))
+    return -1;
+  return FrameHeader + len;
+}
+
+/*
+文本请求的延后格式化（Command::rows）
+* 执行线程只把回复写成结构化的行，数字、日期时间转十进制文本留给写线程
+* 一条记录：2字节长度+原样的时间戳，4字节行的总字节数，之后是和回复帧负载里一样的行
+* 只在进程内部用，不上网络
+*/
+// 开始一条记录，返回EndRowReply要用的位置
+inline size_t BeginRowReply(Writer& w, string_view timestamp) {
+  PutLongStr(w, timestamp);
+  size_t at = w.size();
+  Put32(w, 0);
+  return at;
+}
+inline void EndRowReply(Writer& w, size_t at) {
+  Patch32(w.data() + at, w.size() - at - 4);
+}
+/*
+把一条记录转成文本协议的输出：时间戳、空格、各行
+return: 记录的总字节数；记录不完整或者行不合法返回-1
+*/
+long FormatRowReply(const char* p, size_t n, Writer& out) {
+  WireReader head(p, n);
+  string_view timestamp = head.GetLongStr();
+  uint32_t len = head.Get32();
+  size_t at = 2 + timestamp.size() + 4;
+  if (!head.ok || n - at < len)
+    return -1;
+  out << timestamp << ' ';
+  WireReader r(p + at, len);
+  if (!FormatReplyRows(r, out))
+    return -1;
+  return at + len;
+}
+
+}  // namespace sjtu
+
+#endif  // !SJTU_TICKETSYSTEM_PROTOCOL_HPP
@@ -0,0 +1,275 @@
+#ifndef SJTU_TICKETSYSTEM_SCHEDULER_HPP
+#define SJTU_TICKETSYSTEM_SCHEDULER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Executor.hpp"
+#include "Parser.hpp"
+
+namespace sjtu {
+
+// 不改任何状态的指令，两次写之间的这些指令可以并发执行
+bool IsReadOnly(CommandType type) {
+  switch (type) {
+    case CMD_QUERY_PROFILE:
+    case CMD_QUERY_TRAIN:
+    case CMD_QUERY_TICKET:
+    case CMD_QUERY_TRANSFER:
+    case CMD_QUERY_ORDER:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// 只读B+树和车次记录的查询，可以拿快照和后面的写同时执行
+// query_profile/query_order还要看内存里的登录表，不在此列
+bool IsSnapshotRead(CommandType type) {
+  switch (type) {
+    case CMD_QUERY_TRAIN:
+    case CMD_QUERY_TICKET:
+    case CMD_QUERY_TRANSFER:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/*
+固定大小的线程池
+* 任务先进先出，每个任务属于一个TaskGroup，Wait(group)阻塞到这一组都做完为止
+* 做完之后工作线程的写入对Wait的调用者可见
+*/
+struct TaskGroup {
+  size_t left = 0;  // 还没做完的任务数，由线程池的锁保护
+};
+
+class ThreadPool {
+ private:
+  struct Task {
+    void (*fn)(void*, size_t);
+    void* ctx;
+    size_t k;
+    TaskGroup* group;
+  };
+  std::thread* workers = nullptr;
+  int count = 0;
+  std::mutex m;
+  std::condition_variable wake, finish;
+  bool quit = false;
+
+  Task* ring = nullptr;  // 环形队列
+  size_t ringCap = 0, qhead = 0, qtail = 0;
+
+  void Grow() {
+    size_t cap = ringCap ? ringCap * 2 : 256;
+    Task* fresh = new Task[cap];
+    for (size_t i = qhead; i < qtail; ++i)
+      fresh[i - qhead] = ring[i % ringCap];
+    qtail -= qhead;
+    qhead = 0;
+    delete[] ring;
+    ring = fresh;
+    ringCap = cap;
+  }
+
+  void Loop() {
+    std::unique_lock<std::mutex> lk(m);
+    while (true) {
+      wake.wait(lk, [&] { return quit || qhead != qtail; });
+      if (quit)
+        return;
+      Task t = ring[qhead++ % ringCap];
+      lk.unlock();
+      t.fn(t.ctx, t.k);
+      lk.lock();
+      if (--t.group->left == 0)
+        finish.notify_all();
+    }
+  }
+
+ public:
+  explicit ThreadPool(int n) {
+    count = n > 0 ? n : 0;
+    if (count)
+      workers = new std::thread[count];
+    for (int i = 0; i < count; ++i)
+      workers[i] = std::thread(&ThreadPool::Loop, this);
+  }
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lk(m);
+      quit = true;
+    }
+    wake.notify_all();
+    for (int i = 0; i < count; ++i)
+      workers[i].join();
+    delete[] workers;
+    delete[] ring;
+  }
+  int Size() const {
+    return count;
+  }
+
+  // 异步执行fn(ctx, k)
+  void Submit(void (*fn)(void*, size_t), void* ctx, size_t k, TaskGroup& group) {
+    {
+      std::lock_guard<std::mutex> lk(m);
+      if (qtail - qhead == ringCap)
+        Grow();
+      ring[qtail++ % ringCap] = Task{fn, ctx, k, &group};
+      ++group.left;
+    }
+    wake.notify_one();
+  }
+  void Wait(TaskGroup& group) {
+    std::unique_lock<std::mutex> lk(m);
+    finish.wait(lk, [&] { return group.left == 0; });
+  }
+
+  // 对 [0,n) 的每个下标调用f(k)，由工作线程分着做，做完才返回
+  template <class F>
+  void ParallelFor(size_t n, F& f) {
+    TaskGroup group;
+    for (size_t k = 0; k < n; ++k)
+      Submit([](void* c, size_t i) { (*static_cast<F*>(c))(i); }, &f, k, group);
+    Wait(group);
+  }
+};
+
+/*
+调度器：按顺序执行一串指令
+* 写指令在当前线程逐条执行，前后通知快照登记处
+* query_train/query_ticket/query_transfer拿一个快照异步丢给线程池，当前线程接着往下执行后面的写，
+  快照保证它们看到的还是自己那个时间戳时的数据
+* 其他连续的只读指令凑成一组，丢给线程池并发执行并等它们做完（这期间没有写）
+* 每条指令的输出先各自留在执行它的线程的wout里，一批做完后按原顺序拼回当前线程的wout
+* 线程池为空时退化成逐条执行
+*/
+class Scheduler {
+ private:
+  Executor& executor;
+  ThreadPool pool;
+
+  struct Slot {
+    Writer* w;  // 哪个线程的wout，nullptr表示当前线程
+    size_t off, len;
+  };
+  Slot* slots = nullptr;
+  long long* snaps = nullptr;  // 每条快照读用的快照
+  size_t slotCap = 0;
+  const Command* cmds = nullptr;
+  Writer local{nullptr};  // 执行一批期间，当前线程原来wout里的内容先换到这里
+
+  // 在当前线程的wout里执行一条，记下输出的位置
+  void ExecuteInto(size_t k, Writer* owner, bool& running) {
+    Writer& w = wout;
+    size_t off = w.size();
+    running = executor.Execute(cmds[k]);
+    slots[k] = Slot{owner, off, w.size() - off};
+  }
+
+  static void SnapshotTask(void* c, size_t k) {
+    Scheduler* self = static_cast<Scheduler*>(c);
+    SnapshotScope scope(self->snaps[k]);
+    bool running;
+    self->ExecuteInto(k, &wout, running);
+  }
+
+  void RunGroup(size_t beg, size_t end) {
+    Scheduler* self = this;
+    auto task = [self, beg](size_t k) {
+      bool running;
+      self->ExecuteInto(beg + k, &wout, running);
+    };
+    pool.ParallelFor(end - beg, task);
+  }
+
+  void Reserve(size_t n) {
+    if (slotCap >= n)
+      return;
+    delete[] slots;
+    delete[] snaps;
+    slotCap = n * 2;
+    slots = new Slot[slotCap];
+    snaps = new long long[slotCap];
+  }
+
+ public:
+  Scheduler(Executor& ex, int threads)
+      : executor(ex), pool(threads) {}
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+  ~Scheduler() {
+    delete[] slots;
+    delete[] snaps;
+  }
+
+  // 返回false表示执行到了exit，后面的不再执行
+  bool Run(const Command* cmds_, size_t n) {
+    if (!pool.Size()) {
+      for (size_t i = 0; i < n; ++i) {
+        if (executor.NeedSettle(cmds_[i].type))
+          executor.Settle();
+        if (!executor.Execute(cmds_[i]))
+          return false;
+      }
+      return true;
+    }
+    Reserve(n);
+    cmds = cmds_;
+    wout.swap(local);
+    TaskGroup async;
+    bool running = true;
+    size_t i = 0;
+    while (i < n && running) {
+      CommandType type = cmds[i].type;
+      if (executor.NeedSettle(type)) {
+        // 结算是写，而且要在后面的查询拿快照、进线程池之前做完
+        snapshots.BeginWrite();
+        executor.Settle();
+        snapshots.EndWrite();
+      }
+      if (IsSnapshotRead(type)) {
+        snaps[i] = snapshots.Acquire();
+        pool.Submit(&Scheduler::SnapshotTask, this, i, async);
+        ++i;
+      } else if (IsReadOnly(type)) {
+        size_t j = i + 1;  // 只读指令不会留下待结算的，组里不用再检查
+        while (j < n && IsReadOnly(cmds[j].type) && !IsSnapshotRead(cmds[j].type))
+          ++j;
+        if (j - i == 1)
+          ExecuteInto(i, nullptr, running);
+        else
+          RunGroup(i, j);
+        i = j;
+      } else {
+        snapshots.BeginWrite();
+        ExecuteInto(i, nullptr, running);
+        snapshots.EndWrite();
+        ++i;
+      }
+    }
+    pool.Wait(async);
+    wout.swap(local);
+    // local现在是当前线程这一批的输出，wout是原来的内容
+    for (size_t k = 0; k < i; ++k) {
+      Writer* w = slots[k].w ? slots[k].w : &local;
+      wout.write(w->data() + slots[k].off, slots[k].len);
+    }
+    for (size_t k = 0; k < i; ++k)
+      if (slots[k].w)
+        slots[k].w->clear();
+    local.clear();
+    return running;
+  }
+};
+
+}  // namespace sjtu
+
+#endif  // !SJTU_TICKETSYSTEM_SCHEDULER_HPP
@@ -0,0 +1,314 @@
+#ifndef SJTU_TICKETSYSTEM_SERVER_HPP
+#define SJTU_TICKETSYSTEM_SERVER_HPP
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+
+#include "Pipeline.hpp"
+#include "Protocol.hpp"
+#include "Scheduler.hpp"
+
+namespace sjtu {
+
+/*
+服务器模式
+* 监听Unix域套接字（可选再监听127.0.0.1上的TCP端口），协议和标准输入一样，一行一条指令
+* 单线程epoll事件循环，所有连接共用同一个TicketSystem（通过Scheduler/Executor）
+* 每个连接读到的完整行整批交给Scheduler，输出按行序写回这个连接，连接之间互不影响顺序
+* exit只关闭发出它的连接；SIGINT/SIGTERM让服务器正常退出，数据文件照常落盘
+* 某个连接积压的输出太多时先不读它的输入，等对方把输出收走
+* 一直不给换行（或帧不完整）的连接，攒下的输入超过MaxInput就不再读，发完已有的输出后断开
+* 连接的第一个字节是RequestMagic时这个连接改走二进制协议（见Protocol.hpp），回复也是二进制帧；坏帧直接断开
+*/
+class Server {
+ private:
+  static const size_t ReadChunk = 1 << 16;
+  static const size_t MaxPending = 1 << 22;  // 积压超过这么多就暂停读
+  static const size_t MaxInput = 1 << 21;    // 还没凑成一行/一帧的输入最多这么多，超过就断开；比最大的帧大
+
+  struct Conn {
+    int fd;
+    Batch batch;       // 输入缓冲、解析出的指令、待发送的输出
+    size_t sent = 0;   // output里已经发出去的字节数
+    bool eof = false;  // 对方已经关了写端
+    bool closing = false;  // 发完输出就关
+    int binary = -1;       // 是否二进制协议，-1表示还没收到第一个字节
+    // 输出由Flush发给对方，析构时不能落到服务器的stdout
+    explicit Conn(int fd_)
+        : fd(fd_), batch(ReadChunk, nullptr) {}
+    size_t Pending() const {
+      return batch.output.size() - sent;
+    }
+  };
+
+  Scheduler& scheduler;
+  int ep = -1, unixFd = -1, tcpFd = -1, sigFd = -1;
+  std::string unixPath;
+  vector<Conn*> conns;  // 下标是fd
+  bool running = true;
+
+  static void SetNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  }
+  void Watch(int fd, unsigned events, int op = EPOLL_CTL_ADD) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(ep, op, fd, &ev);
+  }
+  bool Listen(int fd) {
+    if (listen(fd, 128) < 0) {
+      perror("listen");
+      return false;
+    }
+    SetNonBlocking(fd);
+    return true;
+  }
+
+  void Accept(int lfd) {
+    while (true) {
+      int fd = accept(lfd, nullptr, nullptr);
+      if (fd < 0)
+        return;  // EAGAIN：这一轮接完了
+      SetNonBlocking(fd);
+      while (conns.size() <= (size_t)fd)
+        conns.push_back(nullptr);
+      conns[fd] = new Conn(fd);
+      Watch(fd, EPOLLIN | EPOLLRDHUP);
+    }
+  }
+  void Close(Conn* c) {
+    epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, nullptr);
+    close(c->fd);
+    conns[c->fd] = nullptr;
+    delete c;
+  }
+
+  /*
+  把b->input里完整的请求帧解析进b->cmds，返回第一个未消费字节的位置
+  * 遇到exit就停，stop置true；遇到坏帧把bad置true，后面的输入都不要了
+  */
+  static size_t ParseFrames(Batch* b, bool& stop, bool& bad) {
+    size_t beg = 0;
+    Command cmd;
+    while (beg < b->len) {
+      long n = DecodeRequest(b->input + beg, b->len - beg, cmd);
+      if (n == 0)
+        break;  // 半帧，留给下一批
+      if (n < 0) {
+        bad = true;
+        return b->len;
+      }
+      b->cmds.push_back(cmd);
+      beg += n;
+      if (cmd.type == CMD_EXIT) {
+        stop = true;
+        return b->len;
+      }
+    }
+    return beg;
+  }
+
+  // 执行已经读到的完整行（或帧）
+  void Process(Conn* c) {
+    Batch* b = &c->batch;
+    b->cmds.clear();
+    bool stop = false, bad = false;
+    if (c->binary < 0 && b->len)
+      c->binary = static_cast<unsigned char>(b->input[0]) == RequestMagic;
+    size_t used = c->binary > 0 ? ParseFrames(b, stop, bad) : ParseLines(b, c->eof, stop);
+    if (!b->cmds.empty()) {
+      if (!scheduler.Run(&b->cmds[0], b->cmds.size()))
+        stop = true;
+      b->output.write(wout.data(), wout.size());
+      wout.clear();
+    }
+    if (stop || bad || c->eof)
+      c->closing = true;
+    memmove(b->input, b->input + used, b->len - used);
+    b->len -= used;
+  }
+
+  // 尽量发出积压的输出，返回连接是否还活着
+  bool Flush(Conn* c) {
+    Writer& out = c->batch.output;
+    while (c->Pending()) {
+      ssize_t n = send(c->fd, out.data() + c->sent, c->Pending(), MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          break;
+        Close(c);  // 对方已经走了
+        return false;
+      }
+      c->sent += n;
+    }
+    if (!c->Pending()) {
+      out.clear();
+      c->sent = 0;
+      if (c->closing) {
+        Close(c);
+        return false;
+      }
+    }
+    unsigned events = c->eof ? 0u : static_cast<unsigned>(EPOLLRDHUP);
+    if (!c->closing && c->Pending() < MaxPending)
+      events |= EPOLLIN;
+    if (c->Pending())
+      events |= EPOLLOUT;
+    Watch(c->fd, events, EPOLL_CTL_MOD);
+    return true;
+  }
+
+  void OnReadable(Conn* c) {
+    Batch* b = &c->batch;
+    b->Reserve(ReadChunk);
+    ssize_t n = read(c->fd, b->input + b->len, b->cap - b->len);
+    if (n == 0) {
+      c->eof = true;
+    } else if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        Close(c);
+        return;
+      }
+    } else {
+      b->len += n;
+    }
+    Process(c);
+    if (b->len > MaxInput) {
+      b->len = 0;
+      c->closing = true;
+    }
+    Flush(c);
+  }
+
+  void OnEvent(const epoll_event& ev) {
+    int fd = ev.data.fd;
+    if (fd == sigFd) {
+      running = false;
+      return;
+    }
+    if (fd == unixFd || fd == tcpFd) {
+      Accept(fd);
+      return;
+    }
+    Conn* c = conns[fd];
+    if (!c)
+      return;
+    if (ev.events & EPOLLERR) {
+      Close(c);
+      return;
+    }
+    if (ev.events & EPOLLOUT) {
+      if (!Flush(c))
+        return;
+    }
+    if (ev.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+      OnReadable(c);
+  }
+
+ public:
+  explicit Server(Scheduler& s)
+      : scheduler(s) {
+    ep = epoll_create1(0);
+  }
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+  ~Server() {
+    for (size_t i = 0; i < conns.size(); ++i)
+      if (conns[i])
+        Close(conns[i]);
+    if (unixFd >= 0) {
+      close(unixFd);
+      unlink(unixPath.c_str());
+    }
+    if (tcpFd >= 0)
+      close(tcpFd);
+    if (sigFd >= 0)
+      close(sigFd);
+    close(ep);
+  }
+
+  // 在path上监听Unix域套接字，已经存在的同名文件会被删掉
+  bool ListenUnix(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+      fprintf(stderr, "socket path too long: %s\n", path.c_str());
+      return false;
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    unixFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (bind(unixFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+      perror("bind");
+      return false;
+    }
+    unixPath = path;
+    if (!Listen(unixFd))
+      return false;
+    Watch(unixFd, EPOLLIN);
+    return true;
+  }
+  // 在127.0.0.1:port上监听TCP
+  bool ListenTcp(int port) {
+    tcpFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(tcpFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(tcpFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+      perror("bind");
+      return false;
+    }
+    if (!Listen(tcpFd))
+      return false;
+    Watch(tcpFd, EPOLLIN);
+    return true;
+  }
+
+  static sigset_t StopSignals() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    return mask;
+  }
+  // 屏蔽SIGINT/SIGTERM，改由事件循环里的signalfd处理
+  // 必须在创建任何线程（线程池）之前调用，新线程会继承屏蔽字
+  static void BlockSignals() {
+    sigset_t mask = StopSignals();
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+  }
+
+  // 跑到收到SIGINT/SIGTERM为止
+  void Run() {
+    BlockSignals();
+    sigset_t mask = StopSignals();
+    sigFd = signalfd(-1, &mask, SFD_NONBLOCK);
+    Watch(sigFd, EPOLLIN);
+    wout.flush();
+    epoll_event events[64];
+    while (running) {
+      int n = epoll_wait(ep, events, 64, -1);
+      if (n < 0 && errno != EINTR)
+        break;
+      for (int i = 0; i < n && running; ++i)
+        OnEvent(events[i]);
+    }
+  }
+};
+
+}  // namespace sjtu
+
+#endif  // !SJTU_TICKETSYSTEM_SERVER_HPP
@@ -1,10 +1,18 @@
 #ifndef SJTU_TICKETSYSTEM_TICKET_HPP
 #define SJTU_TICKETSYSTEM_TICKET_HPP
 
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+
 #include "Calendar.hpp"
 #include "TrainSystem.hpp"
 #include "UserSystem.hpp"
+#include "appendlist.hpp"
 #include "bptree.hpp"
+#include "reply.hpp"
+#include "statustable.hpp"
 
 namespace sjtu {
 
@@ -17,6 +25,7 @@ enum OrderType {
   QUEUE,
   REFUNDED
 };
+const int BadStatus = -2;  // query_order -s 给了认不出来的状态
 
 // 一趟直达车
 struct DirectTravel {
@@ -39,6 +48,70 @@ bool comp1(const DirectTravel& lhs, const DirectTravel& rhs) {
     return lhs.trainID < rhs.trainID;
   return lhs.compthing < rhs.compthing;
 }
+
+// trainID前4个字节按大端拼成整数，和strcmp的顺序一致；'\0'之后的字节不一定是0，当0算
+inline uint32_t IdPrefix(const ID& id) {
+  uint32_t v = 0;
+  bool end = false;
+  for (int i = 0; i < 4; ++i) {
+    end |= !id.str[i];
+    v = v << 8 | (end ? 0 : static_cast<unsigned char>(id.str[i]));
+  }
+  return v;
+}
+/*
+query_ticket结果的排序，结果和Sort(v, comp1)一样
+* 键是 (compthing, trainID前4字节) 拼成的64位整数，基数排序
+* 键相同的一段（trainID前缀一样）再用comp1插入排序，一般很短
+* 最后沿着置换环原地换位，不复制整个数组
+* 元素少的时候基数排序的计数开销不划算，直接原地堆排序
+*/
+const int RadixMin = 64;
+template <class A>
+void SortTravel(vector<DirectTravel, A>& v) {
+  int n = v.size();
+  if (n < RadixMin) {
+    TopK(v, n, comp1);
+    return;
+  }
+  thread_local Scratch<RadixItem> scratch;
+  RadixItem* a = scratch.Get(n * 2);
+  for (int i = 0; i < n; ++i) {
+    // compthing翻转符号位，负数也按有符号的顺序排
+    a[i].key = static_cast<uint64_t>(static_cast<uint32_t>(v[i].compthing) ^ 0x80000000u) << 32 | IdPrefix(v[i].trainID);
+    a[i].idx = i;
+  }
+  RadixSort(a, a + n, n);
+  for (int l = 0, r; l < n; l = r) {
+    r = l + 1;
+    while (r < n && a[r].key == a[l].key)
+      ++r;
+    for (int i = l + 1; i < r; ++i) {
+      RadixItem x = a[i];
+      int j = i;
+      for (; j > l && comp1(v[x.idx], v[a[j - 1].idx]); --j)
+        a[j] = a[j - 1];
+      a[j] = x;
+    }
+  }
+  // 现在第i个位置应该放原来的v[a[i].idx]
+  for (int i = 0; i < n; ++i) {
+    if (a[i].idx == i)
+      continue;
+    DirectTravel first = v[i];
+    int j = i;
+    while (true) {
+      int k = a[j].idx;
+      a[j].idx = j;
+      if (k == i) {
+        v[j] = first;
+        break;
+      }
+      v[j] = v[k];
+      j = k;
+    }
+  }
+}
 // comp2用于query_transfer，由于只要最优解，做成了普通的函数
 bool comp2(int price, int tim, const ID& id1, const ID& id2, int curprice, int curtim, const ID& curid1, const ID& curid2, SortType type) {
   if (type == COST) {
@@ -60,23 +133,56 @@ bool comp2(int price, int tim, const ID& id1, const ID& id2, int curprice, int c
   return curid2 < id2;
 }
 
-// 订单
+/*
+订单，20字节定长，存在orderData.dat（以前的ticketData.dat是另一种布局，见OrderFile）
+* 状态不在这里，在单独的StatusTable里
+* 车次号、车站名、出发到达时间的时分都从车次的时刻表取，不存
+* 这趟车真正的发车日期单独存：它是买票时的 d - departTimes[From].days，
+  而Date相减取的是绝对值，salesDate[0] + deltaday 不总是等于它
+*/
 struct Order {
-  // 为了方便写入状态，放在前面了
-  char status;   // 0.成功 1.正在候补，未有票 2.已经退票
-  int trainpos;  // 便于直接找到这个车进行退票时修改
-  int deltaday;  // 减少重复计算
-  int from, to;  // station在这趟车上的位置
-
-  ID userID;  // 谁的订单
-  ID trainID;
-  String fromStation, toStation;
-  DateTime startTime, stopTime;
-  Date startDate;  // 这趟火车的真正发车日期
-  int price;       // 总价格
-  int buy;         // 购买的票数
+  unsigned char from, to;            // station在这趟车上的位置
+  unsigned char startMonth, startDay;  // 这趟火车的真正发车日期
+  short deltaday;                    // 座位表的行
+  int trainpos;                      // 便于直接找到这个车进行退票时修改
+  int price;                         // 单价
+  int buy;                           // 购买的票数
   Order() = default;
 };
+static_assert(sizeof(Order) == 20, "Order layout");
+
+/*
+候补队列里的一项，直接存在queueIndex的值里
+* 退票时判断区间是否相交、余票够不够都只看这里，不用回订单文件读整张订单
+* 同一(车次, 日期)下先按区间起点、再按订单编号排序：退票只要起点在退票区间之前的，
+  扫到起点不在之前的就停，后面的叶子不读（见FindWaiting）
+* id唯一，比较和删除都只需要id和from
+* 记录比只存id时长，所以换了文件名（见QueueIndexFile）
+*/
+struct Pending {
+  int id;         // 订单编号
+  short from, to;  // 区间，车站在这趟车上的位置
+  int buy;
+  Pending() = default;
+  explicit Pending(int id_, int from_ = 0, int to_ = 0, int buy_ = 0)
+      : id(id_), from(from_), to(to_), buy(buy_) {}
+};
+inline bool operator==(const Pending& a, const Pending& b) {
+  return a.id == b.id && a.from == b.from;
+}
+inline bool operator<(const Pending& a, const Pending& b) {
+  return a.from != b.from ? a.from < b.from : a.id < b.id;
+}
+inline bool operator>(const Pending& a, const Pending& b) {
+  return b < a;
+}
+inline bool ArrivedBefore(const Pending& a, const Pending& b) {
+  return a.id < b.id;
+}
+// 候补订单w的区间和 [from, to) 有没有共同的区段
+inline bool Overlaps(const Pending& w, int from, int to) {
+  return w.from < to && from < w.to;
+}
 
 class TicketSystem {
   friend class UserSystem;
@@ -85,46 +191,159 @@ class TicketSystem {
  private:
   int siz = 0;  // 已经有几张订单
   int head = sizeof(int);
-  BPTree<int, int> orderIndex;                // 用户信息-订单存储位置
-  BPTree<Element<int, int>, int> queueIndex;  // 车次编号-相对发车日的日期-订单存储位置
-  std::fstream ofile;                         // 存储订单
-  const string& filename = "ticketData.dat";
+  AppendList orders;                              // 每个用户的订单编号，按下单先后，文件见OrderListName
+  BPTree<Element<int, int>, Pending> queueIndex;  // 车次编号-相对发车日的日期-候补订单，文件见QueueIndexFile
+  File ofile;                                 // 存储订单
+  StatusTable statuses;                       // 每张订单的状态，常驻内存
 
-  vector<Element<int, int> > from;
-  vector<Element<int, int> > to;
   vector<int> res;
+  vector<Pending> waiting;
 
-  void ReadOrder(int pos, Order& ret) {
-    ofile.seekg(pos);
-    ofile.read(reinterpret_cast<char*>(&ret), sizeof(Order));
+  /*
+  延迟结算（可选）
+  * 打开后退掉已购的票只改订单状态，把退出来的区段记进dirty，座位和候补队列都先不动
+  * 下一条不是退票的指令执行之前由Executor统一结算：同一(车次, 日期)上的一串退票先把座位全加回去，
+    再按下单先后扫一遍候补队列；车次记录和队列只读一次、座位只写一次，队列只扫一遍
+  * 和立刻结算的区别：立刻结算时一张候补订单只能用到它之前那些退票退出来的座位，
+    这里能用到这一串退票的全部座位，所以一串退票里后面的退票可能让排在前面的候补先补上
+  * 要退的订单还在候补时先结算，因为前面攒下的退票可能已经让它补上了
+  */
+  struct Freed {
+    Element<int, int> trainDay;
+    short from, to;
+    int buy;
+  };
+  bool deferSettle = false;
+  vector<Freed> dirty;
+
+  /*
+  取出(车次, 日期)上和 [from, to) 相交的候补订单，按下单先后排好放进waiting
+  * 树里按起点排，起点 >= to 的在最后，碰到就停；终点 <= from 的在叶子里筛掉
+  */
+  void FindWaiting(const Element<int, int>& trainDay, int from, int to) {
+    queueIndex.Find(
+        trainDay, waiting,
+        [from](const Pending& w) { return from < w.to; },
+        [to](const Pending& w) { return w.from >= to; });
+    if (waiting.size() > 1)
+      Sort(waiting, ArrivedBefore);
+  }
+  // 候补订单w够票就补上，返回是否补上
+  bool TryFulfil(const Pending& w, int* seats, const Element<int, int>& trainDay) {
+    PhaseScope phase(PHASE_SEAT);
+    for (int j = w.from; j < w.to; ++j)
+      if (seats[j] < w.buy)
+        return false;
+    for (int j = w.from; j < w.to; ++j)
+      seats[j] -= w.buy;
+    statuses.Set(w.id, SUCCESS);
+    queueIndex.Remove(Element<Element<int, int>, Pending>(trainDay, w));
+    return true;
+  }
+  static bool DirtyLess(const Freed& a, const Freed& b) {
+    return a.trainDay < b.trainDay;
+  }
+  /*
+  [from, to)的座位刚退回来，按订单先后补waiting（这个(车次, 日期)的候补队列）
+  * 候补订单入队时就不够票，之后只有和它共享区段的退票才可能让它够，
+    所以和这次退票无关的订单不会被补上；退票区间里的余票全为0时后面的都不用看了
+  * 结算时 [from, to) 是一组退票的总范围，waiting里可能有和哪张退票都不相交的订单，补不上，照样跳过
+  */
+  void FulfilWaiting(int from, int to, int* seats, const Element<int, int>& trainDay) {
+    int freed = 0;
+    for (int j = from; j < to; ++j)
+      freed = std::max(freed, seats[j]);
+    for (size_t i = 0; i < waiting.size() && freed > 0; ++i) {
+      const Pending& w = waiting[i];
+      if (!Overlaps(w, from, to))
+        continue;  // 没有影响
+      if (!TryFulfil(w, seats, trainDay))
+        continue;  // 很遗憾
+      freed = 0;
+      for (int j = from; j < to; ++j)
+        freed = std::max(freed, seats[j]);
+    }
+  }
+
+  /*
+  订单输出用的时刻表
+  * 每个线程缓存最近用过的几趟车，按车次位置直接映射；同一个用户的订单常常集中在几趟车上
+  * 时刻表发布后不变，只有clear之后位置会重用，按TrainSystem的代数作废
+  */
+  struct TimetableCache {
+    static const int Slots = 16;
+    int pos[Slots];
+    unsigned gen[Slots];
+    Timetable table[Slots];
+    TimetableCache() {
+      for (int i = 0; i < Slots; ++i)
+        pos[i] = -1;
+    }
+  };
+  const Timetable& TimetableOf(int pos) const {
+    thread_local TimetableCache cache;
+    int s = pos & (TimetableCache::Slots - 1);
+    unsigned g = TS.generation.load(std::memory_order_relaxed);
+    if (cache.pos[s] != pos || cache.gen[s] != g) {
+      TS.ReadTimetable(pos, cache.table[s]);
+      cache.pos[s] = pos, cache.gen[s] = g;
+    }
+    return cache.table[s];
+  }
+
+  /*
+  记录布局变过的文件换了新名字，旧版本的数据目录里还留着旧名字的文件
+  * 旧数据不迁移；按现在的布局读会错位或者整个丢掉，碰到旧文件就不启动，不能悄悄读错
+  */
+  static void RejectOldFile(const char* name) {
+    if (access(name, F_OK) == 0) {
+      fprintf(stderr, "%s was written by an older version whose data layout is no longer read; old data is not migrated, remove the data files to start over\n", name);
+      exit(1);
+    }
+  }
+  // 候补队列：以前的queueIndex.dat值里只有订单编号
+  static const char* QueueIndexFile() {
+    RejectOldFile("queueIndex.dat");
+    return "queueIndex2.dat";
+  }
+  // 每个用户的订单列表：以前存在orderIndex.dat这棵B+树里，现在是AppendList
+  static const char* OrderListName() {
+    RejectOldFile("orderIndex.dat");
+    return "orderList";
   }
-  void WriteOrder(int pos, const Order& order) {
-    ofile.seekp(pos);
-    ofile.write(reinterpret_cast<const char*>(&order), sizeof(Order));
+  // 订单：以前的ticketData.dat里订单带着车次号、车站名和状态，比现在长
+  static const char* OrderFile() {
+    RejectOldFile("ticketData.dat");
+    return "orderData.dat";
+  }
+
+  // 按订单编号读写
+  void ReadOrder(int id, Order& ret) const {
+    PhaseScope phase(PHASE_RECORD, "Order::Read");
+    ofile.Read(head + id * (long long)sizeof(Order), &ret, sizeof(Order));
+  }
+  void WriteOrder(int id, const Order& order) {
+    PhaseScope phase(PHASE_RECORD, "Order::Write");
+    ofile.Write(head + id * (long long)sizeof(Order), &order, sizeof(Order));
   }
 
  public:
   TrainSystem TS;
   UserSystem US;
   TicketSystem()
-      : orderIndex("orderIndex.dat"), queueIndex("queueIndex.dat") {
-    ofile.open(filename, std::ios::in | std::ios::out | std::ios::binary);
-    if (!ofile.is_open()) {
-      ofile.open(filename, std::ios::out);
-      ofile.close();
-      ofile.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+      : orders(OrderListName()), queueIndex(QueueIndexFile()) {
+    if (!ofile.Open(OrderFile())) {
       siz = 0;
-      ofile.seekp(0);
-      ofile.write(reinterpret_cast<const char*>(&siz), sizeof(int));
+      ofile.Write(0, &siz, sizeof(int));
     } else {
-      ofile.seekg(0);
-      ofile.read(reinterpret_cast<char*>(&siz), sizeof(int));
+      ofile.Read(0, &siz, sizeof(int));
     }
+    statuses.Open("orderStatus.dat", siz);
   }
   ~TicketSystem() {
-    ofile.seekp(0);
-    ofile.write(reinterpret_cast<const char*>(&siz), sizeof(int));
-    ofile.close();
+    SettleWaitlists();
+    ofile.Write(0, &siz, sizeof(int));
+    ofile.Close();
   }
 
   /*
@@ -133,22 +352,22 @@ class TicketSystem {
   检查【起点站的序号是否小于终点站，即车次方向对不对】
   以及【当天有没有车次】
   找到后存到新的vector里面，进行后续排序输出
-  input:始发站，终点站，始发站出发日期，排序规则（true=time,false=）
+  input:始发站，终点站，始发站出发日期，排序规则（true=time,false=），最多输出几个（-1不限）
   自己输出：trainID fromStation DateTime -> toStation DateTime
    */
-  bool QueryTicket(const string& from_, const string& to_, const string& dat, SortType type = TIME) {
+  bool QueryTicket(string_view from_, string_view to_, const Date& d, SortType type = TIME, int limit = -1) const {
     // bpt的find返回的vector，内部元素一定是按照Element排序的，对两个vec直接双指针处理即可
-    TS.stationIndex.Find(from_.c_str(), from);
-    TS.stationIndex.Find(to_.c_str(), to);
-    static Train tr;  // 当前目标车辆
-    static Date d;
-    d = dat;  // 列车从from出发日期
+    // 临时数组都从arena分配，指令结束时一起收回
+    TempVector<Element<int, int> > from, to;
+    TS.stationIndex.Find(String(from_), from);
+    TS.stationIndex.Find(String(to_), to);
+    Train tr;        // 当前目标车辆
     // from和to中存了所有的【车站编号-第几个车站】
-    vector<DirectTravel> travel;  // 用于排序
-    vector<int> timeprice[2];     // 0=time,1=price，就不用判断了
-    vector<int> seat;
-    vector<DateTime> starttime;
-    vector<DateTime> stoptime;
+    TempVector<DirectTravel> travel;  // 用于排序
+    TempVector<int> timeprice[2];     // 0=time,1=price，就不用判断了
+    TempVector<int> seat;
+    TempVector<DateTime> starttime;
+    TempVector<DateTime> stoptime;
     int i = 0, j = 0;
     while (i < from.size() && j < to.size()) {
       if (from[i].key == to[j].key) {
@@ -165,8 +384,11 @@ class TicketSystem {
           timeprice[0].push_back(tr.arriveTimes[to[j].val] - tr.departTimes[from[i].val]);
           timeprice[1].push_back(tr.prices[to[j].val] - tr.prices[from[i].val]);
           int seats = 2147483647, deltaday = d - tr.salesDate[0] - tr.departTimes[from[i].val].days;
-          for (int k = from[i].val; k < to[j].val; ++k)
-            seats = std::min(seats, tr.seats[deltaday][k]);  // 不需要考虑终点站的票数啊
+          {
+            PhaseScope phase(PHASE_SEAT);
+            for (int k = from[i].val; k < to[j].val; ++k)
+              seats = std::min(seats, tr.seats[deltaday][k]);  // 不需要考虑终点站的票数啊
+          }
           seat.push_back(seats);
           tr.arriveTimes[to[j].val].days -= tr.departTimes[from[i].val].days;
           tr.departTimes[from[i].val].days = 0;
@@ -182,16 +404,24 @@ class TicketSystem {
     }
     // 一辆都没有，直接返回
     if (travel.empty()) {
-      cout << "0\n";
+      ReplyInt(0);
       return false;
     }
-    int ppp = travel.size();
     // 排序，按照time或cost第一关键字，trainID第二关键字进行排序
-    Sort(travel, comp1);  // 此时travel中的pos就是我们想要的
-    cout << travel.size() << '\n';
-    for (int i = 0; i < travel.size(); ++i) {
+    // 只要前limit个时用堆选出来再排，不用排整个数组；都要时按整数键基数排序
+    // 同一次查询里车次互不相同，不稳定也没关系
+    int n = travel.size();
+    {
+      PhaseScope phase(PHASE_SORT);
+      if (limit < 0 || limit >= n)
+        SortTravel(travel);  // 此时travel中的pos就是我们想要的
+      else
+        n = TopK(travel, limit, comp1);
+    }
+    ReplyInt(n);
+    for (int i = 0; i < n; ++i) {
       int& p = travel[i].pos;
-      cout << travel[i].trainID << ' ' << from_ << ' ' << starttime[p] << " -> " << to_ << ' ' << stoptime[p] << ' ' << timeprice[1][p] << ' ' << seat[p] << '\n';
+      ReplyTicket(travel[i].trainID.str, from_, starttime[p], to_, stoptime[p], timeprice[1][p], seat[p]);
     }
     return true;
   }
@@ -205,10 +435,10 @@ class TicketSystem {
   input:始发站，终点站，始发站出发日期
   输出：买的两张车票
   */
-  bool QueryTransfer(const string& from_, const string& to_, const string& dat, SortType type = TIME) {
-    Date d(dat);
-    TS.stationIndex.Find(from_.c_str(), from);
-    TS.stationIndex.Find(to_.c_str(), to);
+  bool QueryTransfer(string_view from_, string_view to_, const Date& d, SortType type = TIME) const {
+    TempVector<Element<int, int> > from, to;
+    TS.stationIndex.Find(String(from_), from);
+    TS.stationIndex.Find(String(to_), to);
 
     int price = 2147483647, tim = 2147483647;
     ID id1("~"), id2("~");  // 最大的string
@@ -236,7 +466,7 @@ class TicketSystem {
             if (tr1.stations[x] != tr2.stations[y])
               continue;  // 不一样的两站
             // 这个共有车站不能是from和to
-            String stationName(from_.c_str());
+            String stationName(from_);
             if (tr1.stations[x] == stationName || tr2.stations[y] == stationName)
               continue;
             DateTime fromcome(Date(d + (tr1.arriveTimes[x].days - tr1.departTimes[from[i].val].days)), Time(tr1.arriveTimes[x]) - tr1.arriveTimes[x].days * 1440);
@@ -285,12 +515,12 @@ class TicketSystem {
       }
     }
     if (price == 2147483647) {
-      cout << "0\n";
+      ReplyInt(0);
       return false;
     }
 
     // 可以输出了
-    static Train tr;
+    Train& tr = tr1;
     for (int p = 0; p < 2; ++p) {
       TS.ReadProfile(ans[p], tr);
       int totalprice = tr.prices[stationID[p].val] - tr.prices[stationID[p].key];
@@ -300,7 +530,7 @@ class TicketSystem {
         maxseat = std::min(maxseat, tr.seats[deltaday][i]);
       DateTime depart(realDate[p], tr.departTimes[stationID[p].key]);
       DateTime arrive(realDate[p], tr.arriveTimes[stationID[p].val]);
-      cout << tr.trainID << ' ' << tr.stations[stationID[p].key] << ' ' << depart << " -> " << tr.stations[stationID[p].val] << ' ' << arrive << ' ' << totalprice << ' ' << maxseat << '\n';
+      ReplyTicket(tr.trainID.str, tr.stations[stationID[p].key].str, depart, tr.stations[stationID[p].val].str, arrive, totalprice, maxseat);
     }
     return true;
   }
@@ -309,137 +539,180 @@ class TicketSystem {
   买票，即找到对应的车次，将其区间减
   假如区间减做不到，那么考虑是否候补
   候补的话，放到queueIndex里面，但是怎么查找，不一定知道
-  无论如何，放到orderIndex里面方便后面查找
+  无论如何，追加到这个用户的订单列表里方便后面查找
   */
-  bool BuyTicket(const string& us, const string& tn, const string& dat, const string& from_, const string& to_, int n, bool q) {
+  bool BuyTicket(string_view us, string_view tn, const Date& d, string_view from_, string_view to_, int n, bool q) {
     static ID userID;
-    userID = us.c_str();
+    userID = us;
     int userpos = US.Online(userID);
     if (userpos == -1) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
 
-    TS.trainIndex.Find(tn.c_str(), res);
+    TS.trainIndex.Find(ID(tn), res);
     if (res.empty()) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     Train tr;
     TS.ReadProfile(res[0], tr);
     if (tr.released == 0) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     // 检查余票
     int From = -1, To = -1;
     for (int i = 0; i < tr.stationNum; ++i) {
-      if (tr.stations[i] == from_.c_str())
+      if (from_ == tr.stations[i].str)
         From = i;
-      if (tr.stations[i] == to_.c_str())
+      if (to_ == tr.stations[i].str)
         To = i;
     }
     if (From == -1 || To == -1 || From >= To) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
-    Date d(dat);
     int deltaday = d - tr.salesDate[0] - tr.departTimes[From].days;
     if (deltaday < 0 || deltaday > tr.salesDate[1] - tr.salesDate[0]) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }  // 天数不符合车次性质
     // 检查余票
     if (tr.seatNum < n) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     bool enough = true;
-    for (int i = From; i < To; ++i) {
-      if (tr.seats[deltaday][i] < n) {
-        enough = false;
-        break;
+    {
+      PhaseScope phase(PHASE_SEAT);
+      for (int i = From; i < To; ++i) {
+        if (tr.seats[deltaday][i] < n) {
+          enough = false;
+          break;
+        }
       }
     }
     if (!enough && !q) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }  // 没有余票，不想候补
 
     Order order;
-    order.userID = us.c_str();
-    order.trainID = tn.c_str();
+    Date startDate = d - tr.departTimes[From].days;
+    order.startMonth = startDate.month, order.startDay = startDate.date;
     order.trainpos = res[0];
-    order.startDate = d - tr.departTimes[From].days;
     order.deltaday = deltaday;
     order.from = From;
     order.to = To;
-    order.fromStation = tr.stations[From];
-    order.toStation = tr.stations[To];
-    order.startTime = DateTime(order.startDate, tr.departTimes[From]);
-    order.stopTime = DateTime(order.startDate, tr.arriveTimes[To]);
     order.buy = n;
     order.price = tr.prices[To] - tr.prices[From];
     if (enough) {
       // 有余票，直接购买
-      for (int i = From; i < To; ++i)
-        tr.seats[deltaday][i] -= n;
+      {
+        PhaseScope phase(PHASE_SEAT);
+        for (int i = From; i < To; ++i)
+          tr.seats[deltaday][i] -= n;
+      }
       int totalprice = order.price * n;
-      TS.WriteProfile(res[0], tr);
-      order.status = SUCCESS;
-      orderIndex.Insert(Element<int, int>(userpos, siz));
-      ofile.seekp(head + (siz++) * sizeof(Order));
-      ofile.write(reinterpret_cast<char*>(&order), sizeof(Order));
-      cout << totalprice << '\n';
+      TS.WriteSeats(res[0], deltaday, tr);
+      orders.Append(userpos, siz);
+      statuses.Append(siz, SUCCESS);
+      statuses.Flush();
+      WriteOrder(siz++, order);
+      ReplyInt(totalprice);
       return true;
     }
     // 候补
-    order.status = QUEUE;
-    orderIndex.Insert(Element<int, int>(userpos, siz));
-    queueIndex.Insert(Element<Element<int, int>, int>(Element<int, int>(res[0], deltaday), siz));
-    ofile.seekp(head + (siz++) * sizeof(Order));
-    ofile.write(reinterpret_cast<const char*>(&order), sizeof(order));
-    cout << "queue\n";
+    orders.Append(userpos, siz);
+    statuses.Append(siz, QUEUE);
+    statuses.Flush();
+    queueIndex.Insert(Element<Element<int, int>, Pending>(Element<int, int>(res[0], deltaday), Pending(siz, From, To, n)));
+    WriteOrder(siz++, order);
+    ReplyText("queue");
     return true;
   }
 
+  // 订单在出发站的出发日期
+  Date DepartDate(const Order& order) const {
+    const Timetable& t = TimetableOf(order.trainpos);
+    return DateTime(Date(order.startMonth, order.startDay), t.departTimes[order.from]).date;
+  }
+  void ReplyOrderRow(int status, const Order& order) const {
+    const Timetable& t = TimetableOf(order.trainpos);
+    Date startDate(order.startMonth, order.startDay);
+    DateTime depart(startDate, t.departTimes[order.from]), arrive(startDate, t.arriveTimes[order.to]);
+    ReplyOrder(status, t.trainID.str, t.stations[order.from].str, depart, t.stations[order.to].str, arrive, order.price, order.buy);
+  }
+
   /*
-  查找某个用户购票信息，直接在orderIndex里面找即可
+  查找某个用户购票信息，从这个用户的订单列表里从新到旧读出来
+  * 可以只要一页：跳过最新的offset条，最多limit条（-1不限）；第一行是这次输出的条数
+  * 可以按状态（-1不限）和出发日期 [begin, end] 过滤，offset/limit按过滤之后的数；状态是BadStatus时失败
+  * 不过滤时直接跳到要的那一段，只读这一页的订单
+  * 状态只看内存里的状态表；按日期过滤才要读每张候选订单
   */
-  bool QueryOrder(const string& us) {
-    static ID userID;
-    userID = us.c_str();
-    int userpos = US.Online(userID);
-    if (userpos == -1) {
-      cout << "-1\n";
+  bool QueryOrder(string_view us, int limit = -1, int offset = 0, int status = -1, const Date& begin = Date(1, 1), const Date& end = Date(12, 31)) const {
+    int userpos = US.Online(ID(us));
+    if (userpos == -1 || status == BadStatus) {
+      ReplyInt(-1);
       return false;
     }
-    orderIndex.Find(userpos, res);
-    if (res.empty()) {
-      cout << "0\n";
+    if (offset < 0)
+      offset = 0;
+    if (!limit) {
+      ReplyInt(0);
       return true;
     }
-    cout << res.size() << '\n';
-    static Order order;
-    // 从新到旧，因此反过来
-    for (int i = res.size() - 1; i >= 0; --i) {
-      ofile.seekg(head + res[i] * sizeof(Order));
-      ofile.read(reinterpret_cast<char*>(&order), sizeof(Order));
-      switch (order.status) {
-        case SUCCESS:
-          cout << "[success] ";
-          break;
-        case QUEUE:
-          cout << "[pending] ";
-          break;
-        case REFUNDED:
-          cout << "[refunded] ";
-          break;
-        default:
+    bool byDate = begin != Date(1, 1) || end != Date(12, 31);
+    Order order;
+    if (status < 0 && !byDate) {
+      int n = std::max(orders.Count(userpos) - offset, 0);
+      if (limit > 0)
+        n = std::min(n, limit);
+      ReplyInt(n);
+      if (!n)
+        return true;
+      orders.ForEachNewest(userpos, [&](int id) {
+        int st = statuses.Get(id);
+        if (st > REFUNDED)
           throw;
-      }
-      cout << order.trainID << ' ' << order.fromStation << ' ' << order.startTime << " -> " << order.toStation << ' ' << order.stopTime << ' ' << order.price << ' ' << order.buy << '\n';
+        ReadOrder(id, order);
+        ReplyOrderRow(st, order);
+        return --n > 0;
+      }, offset);
+      return true;
     }
+    // 过滤之后有几条事先不知道，先攒起来
+    struct Row {
+      int status;
+      Order order;
+    };
+    TempVector<Row> rows;
+    int skip = offset;
+    orders.ForEachNewest(userpos, [&](int id) {
+      Row row;
+      row.status = statuses.Get(id);
+      if (status >= 0 && row.status != status)
+        return true;
+      if (byDate) {
+        ReadOrder(id, row.order);
+        Date d = DepartDate(row.order);
+        if (d < begin || end < d)
+          return true;
+      }
+      if (skip) {
+        --skip;
+        return true;
+      }
+      if (!byDate)
+        ReadOrder(id, row.order);
+      rows.push_back(row);
+      return limit < 0 || static_cast<int>(rows.size()) < limit;
+    });
+    ReplyInt(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i)
+      ReplyOrderRow(rows[i].status, rows[i].order);
     return true;
   }
 
@@ -449,81 +722,114 @@ class TicketSystem {
   对应的购票信息修改为refunded
   在候补队列中查找对应的订单，将其删掉（时间戳也是唯一标识，可以直接找到的）
   */
-  bool RefundTicket(const string& us, int pos) {
-    ID userID(us.c_str());
+  bool RefundTicket(string_view us, int pos) {
+    ID userID(us);
     int userpos = US.Online(userID);
     if (userpos == -1) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
-    orderIndex.Find(userpos, res);
-    if ((int)res.size() < pos) {
+    int prepos = orders.Latest(userpos, pos);
+    if (prepos == -1) {
       // 不足
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
-    int p = res.size() - pos;
-    int prepos = res[p];
-    Order order;
-    ofile.seekg(head + prepos * sizeof(Order));
-    ofile.read(reinterpret_cast<char*>(&order), sizeof(order));
-    if (order.status == REFUNDED) {
-      cout << "-1\n";
+    // 状态只看内存里的表，已经退过的不用读订单
+    int status = statuses.Get(prepos);
+    if (status == QUEUE && !dirty.empty()) {
+      SettleWaitlists();
+      status = statuses.Get(prepos);
+    }
+    if (status == REFUNDED) {
+      ReplyInt(-1);
       return false;
     }
-    if (order.status == QUEUE) {
+    Order order;
+    ReadOrder(prepos, order);
+    statuses.Set(prepos, REFUNDED);
+    if (status == QUEUE) {
       // 从候补队列中去掉
-      order.status = REFUNDED;
-      queueIndex.Remove(Element<Element<int, int>, int>(Element<int, int>(order.trainpos, order.deltaday), prepos));
-      ofile.seekp(head + prepos * sizeof(Order));
-      ofile.write(reinterpret_cast<const char*>(&(order.status)), sizeof(order.status));
-      cout << "0\n";
+      queueIndex.Remove(Element<Element<int, int>, Pending>(Element<int, int>(order.trainpos, order.deltaday), Pending(prepos, order.from)));
+      statuses.Flush();
+      ReplyInt(0);
       return true;
     }
-    order.status = REFUNDED;
+    Element<int, int> trainDay(order.trainpos, order.deltaday);
+    if (deferSettle) {
+      Freed f;
+      f.trainDay = trainDay;
+      f.from = order.from, f.to = order.to;
+      f.buy = order.buy;
+      dirty.push_back(f);
+      statuses.Flush();
+      ReplyInt(0);
+      return true;
+    }
+
     // 已经买了票，要修改train的数据
     static Train tr;
     TS.ReadProfile(order.trainpos, tr);
-    for (int i = order.from; i < order.to; ++i)
-      tr.seats[order.deltaday][i] += order.buy;
-
-    // 遍历候补队列，看看当天当车订单还有谁
-    // 由于b+树顺序，返回的vec一定是按照下单顺序正序的，从头遍历
-    queueIndex.Find(Element(order.trainpos, order.deltaday), res);
-    Order tmp;
-    for (int i = 0; i < res.size(); ++i) {
-      ofile.seekg(head + res[i] * sizeof(Order));
-      ofile.read(reinterpret_cast<char*>(&tmp), sizeof(tmp));
-      // 这一步应读入状态-火车编号-特征天数-两个站在这趟车上的位置
-      if (tmp.to < order.from || tmp.from > order.to)
-        continue;          // 没有影响
-      bool enough = true;  // 退票后是否有足够的票了
-      for (int j = tmp.from; j < tmp.to; ++j) {
-        if (tr.seats[order.deltaday][j] < tmp.buy) {
-          enough = false;
-          break;
+    {
+      PhaseScope phase(PHASE_SEAT);
+      for (int i = order.from; i < order.to; ++i)
+        tr.seats[order.deltaday][i] += order.buy;
+    }
+    // 遍历候补队列，看看当天当车订单还有谁，只取和退票区间相交的，按下单先后
+    // 区间和票数都在Pending里，只有真正补上的订单才碰订单文件
+    FindWaiting(trainDay, order.from, order.to);
+    FulfilWaiting(order.from, order.to, tr.seats[order.deltaday], trainDay);
+    TS.WriteSeats(order.trainpos, order.deltaday, tr);
+    // 退票和这次补上的候补一起写回
+    statuses.Flush();
+    ReplyInt(0);
+    return true;
+  }
+
+  void SetDeferredSettle(bool on) {
+    deferSettle = on;
+  }
+  bool Unsettled() const {
+    return !dirty.empty();
+  }
+  /*
+  结算攒下的退票
+  * 不同(车次, 日期)的座位和队列互不影响，按(车次, 日期)分组
+  * 一组：读一次车次记录，把这组退出来的座位全加回去，取一次和总范围相交的候补订单按先后扫一遍，写一次座位
+  * 一组的开销是O(退票数 + 候补订单数)，不随两者的乘积增长
+  */
+  void SettleWaitlists() {
+    if (dirty.empty())
+      return;
+    Sort(dirty, DirtyLess);
+    static Train tr;
+    for (size_t d = 0, e; d < dirty.size(); d = e) {
+      const Element<int, int>& trainDay = dirty[d].trainDay;
+      TS.ReadProfile(trainDay.key, tr);
+      int* seats = tr.seats[trainDay.val];
+      int lo = dirty[d].from, hi = dirty[d].to;
+      {
+        PhaseScope phase(PHASE_SEAT);
+        for (e = d; e < dirty.size() && dirty[e].trainDay == trainDay; ++e) {
+          const Freed& f = dirty[e];
+          for (int i = f.from; i < f.to; ++i)
+            seats[i] += f.buy;
+          lo = std::min(lo, (int)f.from), hi = std::max(hi, (int)f.to);
         }
       }
-      if (!enough)
-        continue;  // 很遗憾
-
-      for (int j = tmp.from; j < tmp.to; ++j)
-        tr.seats[order.deltaday][j] -= tmp.buy;
-      tmp.status = SUCCESS;
-      ofile.seekp(head + res[i] * sizeof(Order));
-      ofile.write(reinterpret_cast<const char*>(&(tmp.status)), sizeof(tmp.status));
-      queueIndex.Remove(Element<Element<int, int>, int>(Element<int, int>(tmp.trainpos, tmp.deltaday), res[i]));
-    }
-    TS.WriteProfile(order.trainpos, tr);
-    ofile.seekp(head + prepos * sizeof(Order));
-    ofile.write(reinterpret_cast<const char*>(&(order.status)), sizeof(order.status));
-    cout << "0\n";
-    return true;
+      FindWaiting(trainDay, lo, hi);
+      FulfilWaiting(lo, hi, seats, trainDay);
+      TS.WriteSeats(trainDay.key, trainDay.val, tr);
+    }
+    dirty.clear();
+    statuses.Flush();
   }
 
   void Clear() {
-    orderIndex.Clear();
+    dirty.clear();
+    orders.Clear();
     queueIndex.Clear();
+    statuses.Clear();
     siz = 0;
   }
 };
@@ -3,6 +3,8 @@
 
 #include "Calendar.hpp"
 #include "bptree.hpp"
+#include "mvcc.hpp"
+#include "reply.hpp"
 #include "utils.hpp"
 
 namespace sjtu {
@@ -91,6 +93,16 @@ struct Train {
   // }
 };
 
+// 车次里订单输出要用的部分：车次号、车站、到发时间，不含座位和价格
+// 发布后不会再改
+struct Timetable {
+  ID trainID;
+  int stationNum;
+  String stations[100];
+  Time departTimes[100];
+  Time arriveTimes[100];
+};
+
 class TrainSystem {
   friend class UserSystem;
   friend class TicketSystem;
@@ -98,40 +110,87 @@ class TrainSystem {
  private:
   int siz = 0;  // 总车数，包括删掉的
   int head = sizeof(int);
+  std::atomic<unsigned> generation{0};  // clear一次加一，clear之后车次位置会重用
 
   sjtu::BPTree<ID, int> trainIndex;
   sjtu::BPTree<String, Element<int, int> > stationIndex;
-  std::fstream tfile;  // 存储真实数据，暂时不知道要不要给station也加一个
+  File tfile;  // 存储真实数据，暂时不知道要不要给station也加一个
   const string tfilename = "TrainData.dat";
 
   vector<int> res;
-  vector<string> tokens;
-  vector<string> anothertokens;
+  vector<string_view> tokens;
+  vector<string_view> anothertokens;
 
   // int empty[501];  // 开一个500大小的空间回收
   // int frontpos;    // 假如empty用满了，直接从frontpos取
 
-  void ReadProfile(int pos, Train& ret) {
-    tfile.seekg(head + pos * sizeof(Train));
-    tfile.read(reinterpret_cast<char*>(&ret), sizeof(Train));
+  // 车次记录的旧内容，key是车次位置，按座位行/发布标记分段存
+  VersionStore versions;
+  // 这次写第一次碰这段：有快照在看的话先存下旧内容
+  void Preserve(int pos, size_t off, size_t len) {
+    PhaseScope phase(PHASE_RECORD, "Train::Preserve");
+    long long v = snapshots.SaveVersion();
+    if (!v || versions.Saved(pos, v, off, len))
+      return;
+    char* old = static_cast<char*>(malloc(len));
+    tfile.Read(head + pos * (long long)sizeof(Train) + off, old, len);
+    versions.Save(pos, v, off, len, old);
+  }
+
+  // 当前线程拿着快照时读快照里的样子
+  void ReadProfile(int pos, Train& ret) const {
+    PhaseScope phase(PHASE_RECORD, "Train::Read");
+    tfile.Read(head + pos * (long long)sizeof(Train), &ret, sizeof(Train));
+    if (readSnapshot)
+      versions.Overlay(pos, readSnapshot, &ret, sizeof(Train));
   }
   void WriteProfile(int pos, const Train& up) {
-    tfile.seekp(head + pos * sizeof(Train));
-    tfile.write(reinterpret_cast<const char*>(&up), sizeof(Train));
+    PhaseScope phase(PHASE_RECORD, "Train::Write");
+    Preserve(pos, 0, sizeof(Train));
+    tfile.Write(head + pos * (long long)sizeof(Train), &up, sizeof(Train));
+  }
+  // 买票/退票只改一天的座位，只写这一行
+  void WriteSeats(int pos, int day, const Train& up) {
+    PhaseScope phase(PHASE_RECORD, "Train::WriteSeats");
+    size_t off = offsetof(Train, seats) + day * sizeof(up.seats[0]);
+    Preserve(pos, off, sizeof(up.seats[0]));
+    tfile.Write(head + pos * (long long)sizeof(Train) + off, up.seats[day], sizeof(up.seats[0]));
+  }
+
+  // 只读时刻表的部分，跳过座位表；时刻表不会变，不用看快照
+  void ReadTimetable(int pos, Timetable& ret) const {
+    PhaseScope phase(PHASE_RECORD, "Train::ReadTimetable");
+    long long base = head + pos * (long long)sizeof(Train);
+    struct {
+      char released;
+      ID trainID;
+      char type;
+      int seatNum;
+      int stationNum;
+    } h;
+    static_assert(sizeof(h) == offsetof(Train, stations), "Train header layout");
+    tfile.Read(base, &h, sizeof(h));
+    ret.trainID = h.trainID;
+    ret.stationNum = h.stationNum;
+    int n = h.stationNum;
+    tfile.Read(base + offsetof(Train, stations), ret.stations, n * sizeof(String));
+    tfile.Read(base + offsetof(Train, departTimes), ret.departTimes, n * sizeof(Time));
+    tfile.Read(base + offsetof(Train, arriveTimes), ret.arriveTimes, n * sizeof(Time));
   }
 
   // 查询是否已发布
-  bool Released(int pos) {
-    static char ch;
-    tfile.seekg(head + pos * sizeof(Train));
-    tfile.read(reinterpret_cast<char*>(&ch), sizeof(ch));
+  bool Released(int pos) const {
+    PhaseScope phase(PHASE_RECORD, "Train::Released");
+    char ch;
+    tfile.Read(head + pos * (long long)sizeof(Train), &ch, sizeof(ch));
     return ch != 0;
   }
   // 改变发布内容
   void ReviseRelease(int pos, bool releaseit = true) {
+    PhaseScope phase(PHASE_RECORD, "Train::ReviseRelease");
     char ch = releaseit;
-    tfile.seekp(head + pos * sizeof(Train));
-    tfile.write(reinterpret_cast<const char*>(&ch), sizeof(ch));
+    Preserve(pos, 0, sizeof(ch));
+    tfile.Write(head + pos * (long long)sizeof(Train), &ch, sizeof(ch));
   }
 
   // // 由于要空间回收，给出一个位置
@@ -153,30 +212,23 @@ class TrainSystem {
  public:
   explicit TrainSystem()
       : trainIndex("TrainIndex.dat"), stationIndex("StationIndex.dat") {
-    tfile.open(tfilename, std::ios::in | std::ios::out | std::ios::binary);
-    if (!tfile.is_open()) {
-      tfile.open(tfilename, std::ios::out);
-      tfile.close();
-      tfile.open(tfilename, std::ios::in | std::ios::out | std::ios::binary);
+    if (!tfile.Open(tfilename)) {
       siz = 0;
-      tfile.seekp(0);
-      tfile.write(reinterpret_cast<const char*>(&siz), sizeof(int));
+      tfile.Write(0, &siz, sizeof(int));
       // tfile.write(reinterpret_cast<const char*>(&frontpos), sizeof(frontpos));
       // memset(empty, 0, sizeof(empty));
       // tfile.write(reinterpret_cast<const char*>(&empty), sizeof(empty));
     } else {
-      tfile.seekg(0);
-      tfile.read(reinterpret_cast<char*>(&siz), sizeof(int));
+      tfile.Read(0, &siz, sizeof(int));
       // tfile.read(reinterpret_cast<char*>(&frontpos), sizeof(frontpos));
       // tfile.read(reinterpret_cast<char*>(&empty), sizeof(empty));
     }
   }
   ~TrainSystem() {
-    tfile.seekp(0);
-    tfile.write(reinterpret_cast<const char*>(&siz), sizeof(siz));
+    tfile.Write(0, &siz, sizeof(siz));
     // tfile.write(reinterpret_cast<const char*>(&frontpos), sizeof(frontpos));
     // tfile.write(reinterpret_cast<const char*>(&empty), sizeof(empty));
-    tfile.close();
+    tfile.Close();
   }
 
   /*
@@ -186,20 +238,20 @@ class TrainSystem {
 * input:略
 * return:成功与否
 */
-  bool AddTrain(const string& id,
+  bool AddTrain(string_view id,
                 int stationnum,
                 int seatnum,
-                const string& stations,
-                const string& prices,
-                const string& starttime,
-                const string& traveltimes,
-                const string& stopovertimes,
-                const string& salesdate,
+                string_view stations,
+                string_view prices,
+                string_view starttime,
+                string_view traveltimes,
+                string_view stopovertimes,
+                string_view salesdate,
                 const char& type) {
     // 先找是不是已经有了
-    trainIndex.Find(id.c_str(), res);
+    trainIndex.Find(ID(id), res);
     if (!res.empty()) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
 
@@ -217,15 +269,15 @@ class TrainSystem {
     SplitString(tokens, prices);
     tr.prices[0] = 0;
     for (int i = 0; i < stationnum - 1; ++i)
-      tr.prices[i + 1] = tr.prices[i] + stoi(tokens[i]);
+      tr.prices[i + 1] = tr.prices[i] + ParseInt(tokens[i]);
     tr.departTimes[0] = starttime;
     SplitString(tokens, traveltimes);
     if (stopovertimes != "_")
       SplitString(anothertokens, stopovertimes);
-    tr.arriveTimes[1] = tr.departTimes[0] + stoi(tokens[0]);
+    tr.arriveTimes[1] = tr.departTimes[0] + ParseInt(tokens[0]);
     for (int i = 1; i < stationnum - 1; ++i) {
-      tr.departTimes[i] = tr.arriveTimes[i] + stoi(anothertokens[i - 1]);
-      tr.arriveTimes[i + 1] = tr.departTimes[i] + stoi(tokens[i]);
+      tr.departTimes[i] = tr.arriveTimes[i] + ParseInt(anothertokens[i - 1]);
+      tr.arriveTimes[i + 1] = tr.departTimes[i] + ParseInt(tokens[i]);
     }
 
     SplitString(tokens, salesdate);
@@ -238,26 +290,26 @@ class TrainSystem {
 
     // 可以写入了
     WriteProfile(siz, tr);
-    trainIndex.Insert(Element<ID, int>(id.c_str(), siz++));
-    cout << "0\n";
+    trainIndex.Insert(Element<ID, int>(ID(id), siz++));
+    ReplyInt(0);
     return true;
   }
 
   /*
   删掉一趟车，必须是未发布的
   */
-  bool DeleteTrain(const string& id) {
-    trainIndex.Find(id.c_str(), res);
+  bool DeleteTrain(string_view id) {
+    trainIndex.Find(ID(id), res);
     if (res.empty()) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     if (Released(res[0])) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
-    trainIndex.Remove(Element<ID, int>(id.c_str(), res[0]));
-    cout << "0\n";
+    trainIndex.Remove(Element<ID, int>(ID(id), res[0]));
+    ReplyInt(0);
     return true;
   }
 
@@ -266,14 +318,14 @@ class TrainSystem {
   * 发布前的车次，不可发售车票，无法被 `query_ticket` 和 `query_transfer` 操作所查询到
   * 发布后的车次不可被删除
   */
-  bool ReleaseTrain(const string& id) {
-    trainIndex.Find(id.c_str(), res);
+  bool ReleaseTrain(string_view id) {
+    trainIndex.Find(ID(id), res);
     if (res.empty()) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     if (Released(res[0])) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     ReviseRelease(res[0]);
@@ -282,7 +334,7 @@ class TrainSystem {
     for (int i = 0; i < tr.stationNum; ++i)
       stationIndex.Insert(Element(tr.stations[i], Element(res[0], i)));
     // 这一步存了这个站->这是第first个车次的第second个车站
-    cout << "0\n";
+    ReplyInt(0);
     return true;
   }
 
@@ -298,35 +350,40 @@ class TrainSystem {
   return:成功与否
   干脆不做成返回string，而是我自己发算了
   */
-  bool QueryTrain(const string& id, const string& dat) {
+  bool QueryTrain(string_view id, const Date& d) const {
     // 在某一天发车，后面的启动时间貌似要直接算出来
-    trainIndex.Find(id.c_str(), res);
+    // 只读：不碰成员里的临时变量，可以和别的查询并发
+    TempVector<int> res;
+    trainIndex.Find(ID(id), res);
     if (res.empty()) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }  // pos=res[0]
-    static Train tr;
-    static Date d;
-    d = dat;
+    Train tr;
     ReadProfile(res[0], tr);
-    int deltaday = dat - tr.salesDate[0];  // 用于seats
+    int deltaday = d - tr.salesDate[0];  // 用于seats
 
     if (d < tr.salesDate[0] || tr.salesDate[1] < d) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
 
-    cout << tr.trainID << ' ' << tr.type << '\n';
-    cout << tr.stations[0] << " xx-xx xx:xx -> " << DateTime(d, tr.departTimes[0]) << ' ' << tr.prices[0] << ' ' << tr.seats[deltaday][0] << '\n';
+    ReplyTrain(tr.trainID.str, tr.type);
+    DateTime leave(d, tr.departTimes[0]);
+    ReplyStop(tr.stations[0].str, nullptr, &leave, tr.prices[0], tr.seats[deltaday][0]);
     for (int i = 1; i < tr.stationNum - 1; ++i) {
-      cout << tr.stations[i] << ' ' << DateTime(d, tr.arriveTimes[i]) << " -> " << DateTime(d, tr.departTimes[i]) << ' ' << tr.prices[i] << ' ' << tr.seats[deltaday][i] << '\n';
+      DateTime arrive(d, tr.arriveTimes[i]);
+      leave = DateTime(d, tr.departTimes[i]);
+      ReplyStop(tr.stations[i].str, &arrive, &leave, tr.prices[i], tr.seats[deltaday][i]);
     }
-    cout << tr.stations[tr.stationNum - 1] << ' ' << DateTime(d, tr.arriveTimes[tr.stationNum - 1]) << " -> xx-xx xx:xx " << tr.prices[tr.stationNum - 1] << " x" << '\n';
+    DateTime arrive(d, tr.arriveTimes[tr.stationNum - 1]);
+    ReplyStop(tr.stations[tr.stationNum - 1].str, &arrive, nullptr, tr.prices[tr.stationNum - 1], -1);
     return true;
   }
 
   void Clear() {
     siz = 0;
+    ++generation;
     trainIndex.Clear();
     stationIndex.Clear();
   }
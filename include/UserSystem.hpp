@@ -2,6 +2,7 @@
 #define SJTU_TICKETSYSTEM_USER_HPP
 
 #include "bptree.hpp"
+#include "reply.hpp"
 #include "utils.hpp"
 
 namespace sjtu {
@@ -17,8 +18,8 @@ struct User {
   // 通过私有数据类型构造
   User(const ID& un, const Word& pw, const Word& nm, const Word& em, int p)
       : userID(un), password(pw), name(nm), mail(em), privilege(p) {}
-  // 通过std::string构造
-  User(const char* un, const char* pw, const char* nm, const char* em, int p)
+  // 通过字符串视图构造
+  User(string_view un, string_view pw, string_view nm, string_view em, int p)
       : userID(un), password(pw), name(nm), mail(em), privilege(p) {}
   User(const User& other)
       : userID(other.userID), password(other.password), name(other.name), mail(other.mail), privilege(other.privilege) {}
@@ -34,9 +35,8 @@ struct User {
   }
   ~User() = default;
 
-  friend std::ostream& operator<<(std::ostream& os, const User& up) {
-    os << up.userID << ' ' << up.name << ' ' << up.mail << ' ' << up.privilege;
-    return os;
+  friend Writer& operator<<(Writer& os, const User& up) {
+    return os << up.userID << ' ' << up.name << ' ' << up.mail << ' ' << up.privilege;
   }
 };
 
@@ -60,41 +60,34 @@ class UserSystem {
   int head = sizeof(int);
   BPTree<ID, int> index;  // 索引库，用户ID-文件指针
   const string ufilename = "UserData.dat";
-  std::fstream ufile;                // 用户数据出入口，存真实数据
+  File ufile;                        // 用户数据出入口，存真实数据
   map<ID, pair<int, int> > onlines;  // 当前在线，用户ID-privilege-文件指针
   User tmp;
   vector<int> res;
 
-  void ReadProfile(int pos, User& ret) {
-    ufile.seekg(head + pos * sizeof(User));
-    ufile.read(reinterpret_cast<char*>(&ret), sizeof(User));
+  void ReadProfile(int pos, User& ret) const {
+    PhaseScope phase(PHASE_RECORD, "User::Read");
+    ufile.Read(head + pos * (long long)sizeof(User), &ret, sizeof(User));
   }
   void WriteProfile(int pos, const User& up) {
-    ufile.seekp(head + pos * sizeof(User));
-    ufile.write(reinterpret_cast<const char*>(&up), sizeof(User));
+    PhaseScope phase(PHASE_RECORD, "User::Write");
+    ufile.Write(head + pos * (long long)sizeof(User), &up, sizeof(User));
   }
 
  public:
   explicit UserSystem()
       : index("UserIndex.dat") {
-    ufile.open(ufilename, std::ios::in | std::ios::out | std::ios::binary);
-    if (!ufile.is_open()) {
+    if (!ufile.Open(ufilename)) {
       // 新建文件，此时siz一定是0
-      ufile.open(ufilename, std::ios::out);
-      ufile.close();
-      ufile.open(ufilename, std::ios::in | std::ios::out | std::ios::binary);
-      ufile.seekp(0);
       siz = 0;
-      ufile.write(reinterpret_cast<const char*>(&siz), sizeof(int));
+      ufile.Write(0, &siz, sizeof(int));
     } else {
-      ufile.seekg(0);
-      ufile.read(reinterpret_cast<char*>(&siz), sizeof(int));
+      ufile.Read(0, &siz, sizeof(int));
     }
   }
   ~UserSystem() {
-    ufile.seekp(0);
-    ufile.write(reinterpret_cast<const char*>(&siz), sizeof(int));
-    ufile.close();
+    ufile.Write(0, &siz, sizeof(int));
+    ufile.Close();
   }
 
   /*
@@ -104,33 +97,33 @@ class UserSystem {
   input:操作者，创建用户ID，密码，姓名，邮箱，权限
   return:成功与否
   */
-  bool AddUser(const string& cu, const string& un, const string& pw, const string& nm, const string& em, const int& p) {
+  bool AddUser(string_view cu, string_view un, string_view pw, string_view nm, string_view em, const int& p) {
     if (siz) {
-      ID cur_user(cu.c_str());
+      ID cur_user(cu);
       auto cit = onlines.find(cur_user);
       if (cit == onlines.end()) {
-        cout << "-1\n";
+        ReplyInt(-1);
         return false;
       }
       // 已登录
       if (cit->second.first <= p) {
-        cout << "-1\n";
+        ReplyInt(-1);
         return false;
       }
       // 权限足够
-      User up(un.c_str(), pw.c_str(), nm.c_str(), em.c_str(), p);
+      User up(un, pw, nm, em, p);
       Element<ID, int> ins(up.userID, siz);
       index.Insert(ins);
       WriteProfile(siz++, up);
-      cout << "0\n";
+      ReplyInt(0);
       return true;
     }
     // 第一用户
-    User up(un.c_str(), pw.c_str(), nm.c_str(), em.c_str(), 10);
+    User up(un, pw, nm, em, 10);
     Element<ID, int> ins(up.userID, siz);
     index.Insert(ins);
     WriteProfile(siz++, up);
-    cout << "0\n";
+    ReplyInt(0);
     return true;
   }
 
@@ -141,24 +134,24 @@ class UserSystem {
   input:ID，密码
   return:成功与否
   */
-  bool Login(const string& un, const string& pw) {
-    index.Find(un.c_str(), res);
+  bool Login(string_view un, string_view pw) {
+    index.Find(ID(un), res);
     if (res.empty()) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     // 有这个用户，res[0]为当前用户profile文件指针
     ReadProfile(res[0], tmp);
     if (onlines.find(tmp.userID) != onlines.end()) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }  // 已经在线
-    if (strcmp(tmp.password.str, pw.c_str())) {
-      cout << "-1\n";
+    if (pw != tmp.password.str) {
+      ReplyInt(-1);
       return false;
     }
     onlines[tmp.userID] = pair<int, int>(tmp.privilege, res[0]);
-    cout << "0\n";
+    ReplyInt(0);
     return true;
   }
 
@@ -168,22 +161,22 @@ class UserSystem {
   input:ID
   return:成功与否
   */
-  bool Logout(const string& un) {
-    index.Find(un.c_str(), res);
+  bool Logout(string_view un) {
+    index.Find(ID(un), res);
     if (res.empty()) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     // 有这个用户
-    ID id(un.c_str());
+    ID id(un);
     auto it = onlines.find(id);
     if (it == onlines.end()) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     onlines.erase(it);
     {
-      cout << "0\n";
+      ReplyInt(0);
       return true;
     }
   }
@@ -195,31 +188,34 @@ class UserSystem {
   * input: cur_user,ID
   * return: 一行字符串，username,name,mailaddr,privilege
   */
-  bool QueryProfile(const string& cu, const string& un) {
+  bool QueryProfile(string_view cu, string_view un) const {
+    // 只读，用局部变量，可以和别的查询并发
+    User tmp;
+    TempVector<int> res;
     // 是否登录？
-    auto it = onlines.find(cu.c_str());
-    if (it == onlines.end()) {
-      cout << "-1\n";
+    auto it = onlines.find(ID(cu));
+    if (it == onlines.cend()) {
+      ReplyInt(-1);
       return false;
     }
     // cur_user在线
     if (cu == un) {
       // 自查
       ReadProfile(it->second.second, tmp);
-      cout << tmp << '\n';
+      ReplyProfile(tmp.userID.str, tmp.name.str, tmp.mail.str, tmp.privilege);
       return true;
     }
-    index.Find(un.c_str(), res);
+    index.Find(ID(un), res);
     if (res.empty()) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     ReadProfile(res[0], tmp);
     if (it->second.first <= tmp.privilege) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
-    cout << tmp << '\n';
+    ReplyProfile(tmp.userID.str, tmp.name.str, tmp.mail.str, tmp.privilege);
     return true;
   }
 
@@ -231,61 +227,61 @@ class UserSystem {
   * input: cur_user,ID,(new pw),(new name),(new mail),(new privilege)
   * return: bool
   */
-  bool ModifyProfile(const string& cu, const string& un, const string& pw, const string& nm, const string& em, const int& p) {
-    auto it = onlines.find(cu.c_str());
+  bool ModifyProfile(string_view cu, string_view un, string_view pw, string_view nm, string_view em, const int& p) {
+    auto it = onlines.find(ID(cu));
     if (it == onlines.end()) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     // 在线
     if (cu == un) {
       // 自查
       if (p >= it->second.first) {
-        cout << "-1\n";
+        ReplyInt(-1);
         return false;
       }
       // 不会改高权限，可以放心改了
       ReadProfile(it->second.second, tmp);
       if (!pw.empty())
-        tmp.password = pw.c_str();
+        tmp.password = pw;
       if (!nm.empty())
-        tmp.name = nm.c_str();
+        tmp.name = nm;
       if (!em.empty())
-        tmp.mail = em.c_str();
+        tmp.mail = em;
       if (p != -1)
         tmp.privilege = p;
       WriteProfile(it->second.second, tmp);
-      cout << tmp << '\n';
+      ReplyProfile(tmp.userID.str, tmp.name.str, tmp.mail.str, tmp.privilege);
       return true;
     }
-    index.Find(un.c_str(), res);
+    index.Find(ID(un), res);
     if (res.empty()) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     // 已经存在
     ReadProfile(res[0], tmp);
     if (it->second.first <= tmp.privilege) {
-      cout << "-1\n";
+      ReplyInt(-1);
       return false;
     }
     if (!pw.empty())
-      tmp.password = pw.c_str();
+      tmp.password = pw;
     if (!nm.empty())
-      tmp.name = nm.c_str();
+      tmp.name = nm;
     if (!em.empty())
-      tmp.mail = em.c_str();
+      tmp.mail = em;
     if (p != -1)
       tmp.privilege = p;
     WriteProfile(res[0], tmp);
-    cout << tmp << '\n';
+    ReplyProfile(tmp.userID.str, tmp.name.str, tmp.mail.str, tmp.privilege);
     return true;
   }
 
   // 检查一个用户是否已登录，登录则返回其用户文件指针，否则返回-1
-  int Online(const ID& us) {
+  int Online(const ID& us) const {
     auto it = onlines.find(us);
-    if (it == onlines.end())
+    if (it == onlines.cend())
       return -1;
     return it->second.second;
   }
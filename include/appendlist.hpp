@@ -0,0 +1,118 @@
+#ifndef SJTU_APPENDLIST_HPP
+#define SJTU_APPENDLIST_HPP
+
+#include <string>
+
+#include "file.hpp"
+
+namespace sjtu {
+
+/*
+每个键一条只追加的int列表，用来存每个用户的订单编号
+* 列表按页存，第j页能放 Base<<j 个，页的大小倍增，所以第i个元素在哪一页、页里第几个都能直接算出来
+* 目录文件里每个键一项：元素个数 + 各页在数据文件里的位置，键是目录里的下标
+* 数据文件开头8字节是已经分配到哪里，页在末尾顺序分配，一页内的元素是连续的
+* 取个数、取第n新的元素都是O(1)次读；从新到旧遍历一页一次读，可以直接跳过最新的若干个
+* 只读操作（Count/Latest/ForEachNewest）可以并发，Append/Clear要和它们互斥（由调度保证）
+*/
+class AppendList {
+ private:
+  static const int Base = 8;    // 第0页的容量
+  static const int Pages = 24;  // 一个键最多 Base*(2^Pages-1) 个元素
+  static const int Chunk = 256;  // 遍历时一次读多少个
+
+  struct Head {
+    int count;
+    int page[Pages];  // 页的起始位置（数据文件里第几个int），没分配的是0
+  };
+
+  File dirFile, dataFile;
+  long long dataEnd;  // 数据文件已经用到第几个int，0号位置放它自己
+
+  // 第i个元素（从0数）所在的页和页内位置
+  static void Locate(int i, int& page, int& off) {
+    page = 31 - __builtin_clz(i / Base + 1);
+    off = i - Base * ((1 << page) - 1);
+  }
+  void ReadHead(int key, Head& h) const {
+    dirFile.Read(key * (long long)sizeof(Head), &h, sizeof(Head));
+  }
+  void WriteHeader() {
+    dataFile.Write(0, &dataEnd, sizeof(dataEnd));
+  }
+
+ public:
+  explicit AppendList(const std::string& name) {
+    dirFile.Open(name + "Dir.dat");
+    if (!dataFile.Open(name + ".dat")) {
+      dataEnd = 2;  // 头占两个int
+      WriteHeader();
+    } else {
+      dataFile.Read(0, &dataEnd, sizeof(dataEnd));
+    }
+  }
+  AppendList(const AppendList&) = delete;
+  AppendList& operator=(const AppendList&) = delete;
+  ~AppendList() {
+    WriteHeader();
+  }
+
+  int Count(int key) const {
+    int n;
+    dirFile.Read(key * (long long)sizeof(Head), &n, sizeof(n));
+    return n;
+  }
+  // 第n新的元素，n从1开始；没有这么多返回-1
+  int Latest(int key, int n) const {
+    Head h;
+    ReadHead(key, h);
+    if (n < 1 || n > h.count)
+      return -1;
+    int page, off, v;
+    Locate(h.count - n, page, off);
+    dataFile.Read((h.page[page] + off) * (long long)sizeof(int), &v, sizeof(v));
+    return v;
+  }
+  void Append(int key, int v) {
+    Head h;
+    ReadHead(key, h);
+    int page, off;
+    Locate(h.count, page, off);
+    if (!off) {
+      h.page[page] = static_cast<int>(dataEnd);
+      dataEnd += Base << page;
+      WriteHeader();
+    }
+    dataFile.Write((h.page[page] + off) * (long long)sizeof(int), &v, sizeof(v));
+    ++h.count;
+    dirFile.Write(key * (long long)sizeof(Head), &h, sizeof(Head));
+  }
+  // 跳过最新的skip个，之后从新到旧对每个元素调用fn(v)，fn返回false就停下
+  template <class F>
+  void ForEachNewest(int key, F fn, int skip = 0) const {
+    Head h;
+    ReadHead(key, h);
+    int buf[Chunk];
+    int i = h.count - skip;  // 还没遍历的是 [0, i)
+    while (i > 0) {
+      int page, off;
+      Locate(i - 1, page, off);
+      int len = off + 1 < Chunk ? off + 1 : Chunk;
+      dataFile.Read((h.page[page] + off + 1 - len) * (long long)sizeof(int), buf, len * sizeof(int));
+      for (int k = len - 1; k >= 0; --k)
+        if (!fn(buf[k]))
+          return;
+      i -= len;
+    }
+  }
+  void Clear() {
+    dirFile.Truncate(0);
+    dataFile.Truncate(0);
+    dataEnd = 2;
+    WriteHeader();
+  }
+};
+
+}  // namespace sjtu
+
+#endif  // !SJTU_APPENDLIST_HPP
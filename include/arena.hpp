@@ -0,0 +1,112 @@
+#ifndef SJTU_ARENA_HPP
+#define SJTU_ARENA_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "vector.hpp"
+
+namespace sjtu {
+
+/*
+按指令回收的线性分配器
+* 每个线程一个；分配就是把指针往后挪，释放什么也不做，Executor每条指令执行完调Reset整个收回
+* 当前块不够时另开一块（至少翻倍），旧块挂在新块开头的链上
+* Reset时如果这条指令开过不止一块，就换成一块和总用量一样大的，之后同样规模的指令不再找系统要内存
+* 只能给一条指令里的临时对象用，活不过这条指令
+*/
+class Arena {
+ private:
+  static const size_t Initial = 1 << 16;
+  static const size_t Header = alignof(std::max_align_t);  // 块开头放上一块的指针
+
+  char* block = nullptr;
+  size_t cap = 0, used = 0;
+  size_t earlier = 0;  // 这条指令在之前的块上用掉的字节数
+
+  static char*& Prev(char* b) {
+    return *reinterpret_cast<char**>(b);
+  }
+  void Grow(size_t need) {
+    size_t size = cap * 2;
+    if (size < Initial)
+      size = Initial;
+    if (size < need + Header)
+      size = need + Header;
+    char* b = static_cast<char*>(malloc(size));
+    if (!b)
+      throw std::bad_alloc();
+    Prev(b) = block;
+    if (block)
+      earlier += used;
+    block = b, cap = size, used = Header;
+  }
+
+ public:
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  ~Arena() {
+    while (block) {
+      char* p = Prev(block);
+      free(block);
+      block = p;
+    }
+  }
+
+  void* Allocate(size_t n, size_t align) {
+    size_t at = (used + align - 1) & ~(align - 1);
+    if (!block || at + n > cap) {
+      Grow(n + align);
+      at = (used + align - 1) & ~(align - 1);
+    }
+    used = at + n;
+    return block + at;
+  }
+  // 收回这条指令分配的所有内存
+  void Reset() {
+    if (block && Prev(block)) {
+      size_t total = earlier + used;
+      while (block) {
+        char* p = Prev(block);
+        free(block);
+        block = p;
+      }
+      cap = 0;
+      Grow(total);
+    }
+    used = Header;
+    earlier = 0;
+  }
+  // 当前一共占着多少字节
+  size_t Capacity() const {
+    return cap;
+  }
+};
+
+thread_local Arena arena;
+
+// 从当前线程的arena里分配，给vector的Alloc参数用
+template <typename T>
+class ArenaAllocator {
+ public:
+  T* allocate(size_t siz) {
+    return static_cast<T*>(arena.Allocate(sizeof(T) * siz, alignof(T)));
+  }
+  void deallocate(T*) {}  // Reset时一起收回
+  void construct(T* p, const T& value) {
+    new (p) T(value);
+  }
+  void destroy(T* p) {
+    p->~T();
+  }
+};
+
+// 一条指令里的临时数组
+template <typename T>
+using TempVector = vector<T, ArenaAllocator<T>>;
+
+}  // namespace sjtu
+
+#endif  // !SJTU_ARENA_HPP
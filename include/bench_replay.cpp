@@ -0,0 +1,287 @@
+#include <sys/resource.h>
+
+#include <chrono>
+
+#include "Executor.hpp"
+#include "Parser.hpp"
+#include "TicketSystem.hpp"
+
+// 回放基准：在一个全新的数据目录里按顺序回放若干个trace，逐条计时，和期望输出对拍
+// bench_replay [--dir BASE] [--keep] [--strict] [--defer-settle] trace[:expected]...
+// * 至少给一个trace；第一个trace要能从空数据库跑起来（比如gen_trace的输出），
+//   仓库里的in.in是接着之前的数据跑的，单独回放对不上
+// * 没写期望输出时，X.in旁边有X.out就用它，否则不对拍
+// * 多个trace共用一个数据目录，依次接着跑，可以回放切成几段的长用例；exit只结束它所在的trace
+// * 结果是一个JSON对象，写到标准输出；--strict时对不上返回1
+// * --dir指定在哪里建临时数据目录（默认/tmp），--keep跑完不删
+// * --defer-settle打开候补的延迟结算，结算时间算在触发它的那条指令上
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Trace {
+  std::string path, expected;
+  size_t commands = 0;
+  double seconds = 0;
+  size_t outputBytes = 0;
+  long mismatches = -1;  // -1表示没有对拍
+  long firstMismatch = 0;  // 第一处不同的输出行号，从1开始
+};
+
+// 进程的累计I/O，来自/proc/self/io
+struct IoCounters {
+  long long rchar = 0, wchar = 0, syscr = 0, syscw = 0;
+};
+IoCounters ReadIo() {
+  IoCounters io;
+  FILE* f = fopen("/proc/self/io", "r");
+  if (!f)
+    return io;
+  char key[64];
+  long long v;
+  while (fscanf(f, "%63[^:]: %lld\n", key, &v) == 2) {
+    if (!strcmp(key, "rchar"))
+      io.rchar = v;
+    else if (!strcmp(key, "wchar"))
+      io.wchar = v;
+    else if (!strcmp(key, "syscr"))
+      io.syscr = v;
+    else if (!strcmp(key, "syscw"))
+      io.syscw = v;
+  }
+  fclose(f);
+  return io;
+}
+
+bool ReadFile(const std::string& path, sjtu::Writer& buf) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  while (true) {
+    size_t n = fread(buf.reserve(1 << 16), 1, 1 << 16, f);
+    if (!n)
+      break;
+    buf.commit(n);
+  }
+  fclose(f);
+  return true;
+}
+
+// 逐行比较，返回不同的行数，first记第一处
+long CompareLines(string_view got, string_view want, long& first) {
+  long bad = 0, line = 0;
+  first = 0;
+  while (!got.empty() || !want.empty()) {
+    ++line;
+    size_t a = got.find('\n'), b = want.find('\n');
+    string_view x = got.substr(0, a), y = want.substr(0, b);
+    got = a == string_view::npos ? string_view() : got.substr(a + 1);
+    want = b == string_view::npos ? string_view() : want.substr(b + 1);
+    if (x != y) {
+      if (!bad)
+        first = line;
+      ++bad;
+    }
+  }
+  return bad;
+}
+
+bool LessLL(const long long& a, const long long& b) {
+  return a < b;
+}
+
+void JsonString(sjtu::Writer& out, string_view s) {
+  out << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      out << '\\';
+    out << c;
+  }
+  out << '"';
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string base = "/tmp";
+  bool keep = false, strict = false, deferSettle = false;
+  sjtu::vector<Trace> traces;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--dir") && i + 1 < argc) {
+      base = argv[++i];
+    } else if (!strcmp(argv[i], "--keep")) {
+      keep = true;
+    } else if (!strcmp(argv[i], "--strict")) {
+      strict = true;
+    } else if (!strcmp(argv[i], "--defer-settle")) {
+      deferSettle = true;
+    } else {
+      Trace t;
+      std::string arg = argv[i];
+      size_t colon = arg.find(':');
+      t.path = arg.substr(0, colon);
+      if (colon != std::string::npos) {
+        t.expected = arg.substr(colon + 1);
+      } else if (t.path.size() > 3 && t.path.compare(t.path.size() - 3, 3, ".in") == 0) {
+        std::string out = t.path.substr(0, t.path.size() - 3) + ".out";
+        if (std::filesystem::exists(out))
+          t.expected = out;
+      }
+      traces.push_back(t);
+    }
+  }
+  if (traces.empty()) {
+    fprintf(stderr, "usage: %s [--dir BASE] [--keep] [--strict] [--defer-settle] trace[:expected]...\n", argv[0]);
+    return 2;
+  }
+  for (size_t i = 0; i < traces.size(); ++i)
+    traces[i].path = std::filesystem::absolute(traces[i].path).string();
+  for (size_t i = 0; i < traces.size(); ++i)
+    if (!traces[i].expected.empty())
+      traces[i].expected = std::filesystem::absolute(traces[i].expected).string();
+
+  // 先把所有trace读进内存，回放期间的I/O只算数据文件的
+  sjtu::vector<sjtu::Writer*> inputs;
+  for (size_t i = 0; i < traces.size(); ++i) {
+    inputs.push_back(new sjtu::Writer(nullptr));
+    if (!ReadFile(traces[i].path, *inputs[i])) {
+      fprintf(stderr, "cannot read %s\n", traces[i].path.c_str());
+      return 2;
+    }
+  }
+
+  std::string dir = base + "/bench_replay.XXXXXX";
+  if (!mkdtemp(&dir[0])) {
+    perror("mkdtemp");
+    return 2;
+  }
+  std::string cwd = std::filesystem::current_path().string();
+  std::filesystem::current_path(dir);
+
+  sjtu::vector<long long> latency[sjtu::CMD_UNKNOWN + 1];  // 纳秒
+  sjtu::Writer output(nullptr);
+  output.swap(sjtu::wout);  // 输出只攒着对拍，不写出去
+  IoCounters before = ReadIo();
+  Clock::time_point start = Clock::now();
+  {
+    sjtu::TicketSystem* ks = new sjtu::TicketSystem;
+    ks->SetDeferredSettle(deferSettle);
+    sjtu::Executor executor(*ks);
+    for (size_t t = 0; t < traces.size(); ++t) {
+      bool running = true;  // exit只结束当前这个trace
+      string_view rest(inputs[t]->data(), inputs[t]->size());
+      size_t outBeg = sjtu::wout.size();
+      sjtu::Command cmd;
+      Clock::time_point traceStart = Clock::now();
+      while (!rest.empty() && running) {
+        size_t nl = rest.find('\n');
+        string_view line = rest.substr(0, nl);
+        rest = nl == string_view::npos ? string_view() : rest.substr(nl + 1);
+        if (!line.empty() && line.back() == '\r')
+          line.remove_suffix(1);
+        Clock::time_point t0 = Clock::now();
+        if (!sjtu::ParseCommand(line, cmd))
+          continue;
+        if (executor.NeedSettle(cmd.type))
+          executor.Settle();
+        running = executor.Execute(cmd);
+        latency[cmd.type].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count());
+        ++traces[t].commands;
+      }
+      traces[t].seconds = std::chrono::duration<double>(Clock::now() - traceStart).count();
+      traces[t].outputBytes = sjtu::wout.size() - outBeg;
+      if (!traces[t].expected.empty()) {
+        sjtu::Writer want(nullptr);
+        if (ReadFile(traces[t].expected, want))
+          traces[t].mismatches = CompareLines(string_view(sjtu::wout.data() + outBeg, traces[t].outputBytes),
+                                              string_view(want.data(), want.size()), traces[t].firstMismatch);
+      }
+    }
+    delete ks;  // 析构时落盘，算进总时间和I/O
+  }
+  double total = std::chrono::duration<double>(Clock::now() - start).count();
+  IoCounters after = ReadIo();
+  output.swap(sjtu::wout);
+  output.clear();
+
+  std::filesystem::current_path(cwd);
+  if (!keep)
+    std::filesystem::remove_all(dir);
+  for (size_t i = 0; i < inputs.size(); ++i)
+    delete inputs[i];
+
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  sjtu::Writer& out = sjtu::wout;
+  size_t commands = 0;
+  bool ok = true;
+  out << "{\n  \"traces\": [";
+  for (size_t i = 0; i < traces.size(); ++i) {
+    const Trace& t = traces[i];
+    commands += t.commands;
+    out << (i ? ",\n" : "\n") << "    {\"file\": ";
+    JsonString(out, t.path);
+    out << ", \"commands\": " << t.commands;
+    char num[64];
+    snprintf(num, sizeof(num), "%.6f", t.seconds);
+    out << ", \"seconds\": " << num;
+    snprintf(num, sizeof(num), "%.1f", t.seconds > 0 ? t.commands / t.seconds : 0.0);
+    out << ", \"commands_per_sec\": " << num << ", \"output_bytes\": " << t.outputBytes;
+    if (t.mismatches < 0) {
+      out << ", \"verified\": null}";
+      continue;
+    }
+    out << ", \"expected\": ";
+    JsonString(out, t.expected);
+    out << ", \"verified\": " << (t.mismatches ? "false" : "true");
+    out << ", \"mismatched_lines\": " << static_cast<long long>(t.mismatches);
+    if (t.mismatches) {
+      ok = false;
+      out << ", \"first_mismatch_line\": " << static_cast<long long>(t.firstMismatch);
+    }
+    out << '}';
+  }
+  char num[64];
+  snprintf(num, sizeof(num), "%.6f", total);
+  out << "\n  ],\n  \"commands\": " << commands << ",\n  \"seconds\": " << num;
+  snprintf(num, sizeof(num), "%.1f", total > 0 ? commands / total : 0.0);
+  out << ",\n  \"commands_per_sec\": " << num;
+  // 各类指令的延迟分位数，微秒
+  out << ",\n  \"latency_us\": {";
+  bool firstType = true;
+  for (int k = 0; k <= sjtu::CMD_UNKNOWN; ++k) {
+    sjtu::vector<long long>& v = latency[k];
+    if (v.empty())
+      continue;
+    sjtu::Sort(v, LessLL);
+    long long sum = 0;
+    for (size_t i = 0; i < v.size(); ++i)
+      sum += v[i];
+    auto pct = [&](double p) {
+      return v[static_cast<size_t>(p * (v.size() - 1) + 0.5)] / 1000.0;
+    };
+    out << (firstType ? "\n" : ",\n") << "    ";
+    JsonString(out, k < sjtu::CMD_UNKNOWN ? sjtu::CommandNames[k] : "unknown");
+    snprintf(num, sizeof(num), "%.2f", sum / 1000.0 / v.size());
+    out << ": {\"count\": " << v.size() << ", \"mean\": " << num;
+    snprintf(num, sizeof(num), "%.2f", pct(0.5));
+    out << ", \"p50\": " << num;
+    snprintf(num, sizeof(num), "%.2f", pct(0.9));
+    out << ", \"p90\": " << num;
+    snprintf(num, sizeof(num), "%.2f", pct(0.99));
+    out << ", \"p99\": " << num;
+    snprintf(num, sizeof(num), "%.2f", v[v.size() - 1] / 1000.0);
+    out << ", \"max\": " << num << '}';
+    firstType = false;
+  }
+  // 回放期间数据文件的读写（trace在开始前已经读进内存）
+  out << "\n  },\n  \"io\": {\"read_bytes\": " << after.rchar - before.rchar
+      << ", \"write_bytes\": " << after.wchar - before.wchar
+      << ", \"read_calls\": " << after.syscr - before.syscr
+      << ", \"write_calls\": " << after.syscw - before.syscw << "},\n";
+  out << "  \"peak_rss_kb\": " << static_cast<long long>(usage.ru_maxrss) << "\n}\n";
+  out.flush();
+  return strict && !ok ? 1 : 0;
+}
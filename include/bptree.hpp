@@ -1,6 +1,15 @@
 #ifndef SJTU_BPTREE_HPP
 #define SJTU_BPTREE_HPP
 
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#include "file.hpp"
+#include "mvcc.hpp"
+#include "stats.hpp"
 #include "utils.hpp"
 
 #define GENERAL_TEMPLATE template <class keyType, class valueType>
@@ -77,75 +86,192 @@ struct Block {
   int chd[MaxSize + 3];  // 下属的块在哪个位置
 };
 
+/*
+块的读写锁表
+* 按块号分段，每段1024把锁，段只在第一次用到时分配，分配后地址不再变
+* 分段指针用原子量CAS安装，查锁不需要全局锁
+*/
+class LatchTable {
+ private:
+  static const int ChunkBits = 10, ChunkSize = 1 << ChunkBits, MaxChunks = 1 << 12;
+  std::atomic<std::shared_mutex*> chunks[MaxChunks] = {};
+
+ public:
+  LatchTable() = default;
+  LatchTable(const LatchTable&) = delete;
+  LatchTable& operator=(const LatchTable&) = delete;
+  ~LatchTable() {
+    for (int i = 0; i < MaxChunks; ++i)
+      delete[] chunks[i].load(std::memory_order_relaxed);
+  }
+  std::shared_mutex& operator[](int pos) {
+    std::atomic<std::shared_mutex*>& slot = chunks[pos >> ChunkBits];
+    std::shared_mutex* chunk = slot.load(std::memory_order_acquire);
+    if (!chunk) {
+      std::shared_mutex* fresh = new std::shared_mutex[ChunkSize];
+      if (slot.compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel))
+        chunk = fresh;
+      else
+        delete[] fresh;  // 别的线程先装上了，chunk已经被改成它的
+    }
+    return chunk[pos & (ChunkSize - 1)];
+  }
+};
+
+/*
+B+树
+* 并发控制用latch crabbing：每个块一把读写锁，另有rootLatch保护root
+* 读：从根往下，拿到孩子的读锁再放父亲；沿叶子链往右走时用try_lock，拿不到就从根重来
+* 写：从根往下拿写锁，遇到“安全”的孩子（这次操作不会让它裂开/并块）就放掉所有祖先
+* 兄弟块只在持有父亲写锁时加锁，从左往右、从右往左都可能，所以读者走叶子链不能阻塞等待
+* 分配/回收块号走allocLatch
+* 快照读（readSnapshot非0）不加任何锁：读文件后用versions里的旧块盖上去，写者覆盖块之前先存旧块
+*/
 template <class keyType, class valueType>
 class BPTree {
  private:
+  using BlockType = Block<keyType, valueType>;
   int nowsize = -1;  // 最后一个块的位置
-  std::fstream _file;
+  File _file;
   std::string _filename;
   int recycle[5001];
-  void rdall(int pos, Block<keyType, valueType>& blk) {
+  // 文件头：nowsize, root, recycle；之后是一个个块
+  static long long Offset(int pos) {
+    return pos * (long long)sizeof(Block<keyType, valueType>) + sizeof(int) * 2 + sizeof(recycle);
+  }
+  // 块的前半部分（不含chd），叶子只需要这部分
+  static const size_t FirstSize = offsetof(BlockType, chd);
+  void rdall(int pos, Block<keyType, valueType>& blk) const {
     if (pos < 0)
       exit(-1);
-    _file.seekg(pos * sizeof(Block<keyType, valueType>) + sizeof(int) * 2 + sizeof(recycle));
-    _file.read(reinterpret_cast<char*>(&blk), sizeof(blk));
+    _file.Read(Offset(pos), &blk, sizeof(blk));
   }
   void wtall(int pos, const Block<keyType, valueType>& blk) {
     if (pos < 0)
       exit(-1);
-    _file.seekp(pos * sizeof(Block<keyType, valueType>) + sizeof(int) * 2 + sizeof(recycle));
-    _file.write(reinterpret_cast<const char*>(&blk), sizeof(blk));
+    Preserve(pos);
+    _file.Write(Offset(pos), &blk, sizeof(blk));
   }
-  void rdfirst(int pos, Block<keyType, valueType>& blk) {
+  void rdfirst(int pos, Block<keyType, valueType>& blk) const {
     if (pos < 0)
       exit(-1);
-    _file.seekg(pos * sizeof(Block<keyType, valueType>) + sizeof(int) * 2 + sizeof(recycle));
-    _file.read(reinterpret_cast<char*>(&(blk.isLeaf)), sizeof(blk.isLeaf));
-    _file.read(reinterpret_cast<char*>(&(blk.siz)), sizeof(blk.siz));
-    _file.read(reinterpret_cast<char*>(&(blk.nxt)), sizeof(blk.nxt));
-    _file.read(reinterpret_cast<char*>(&(blk.ele)), sizeof(blk.ele));
+    _file.Read(Offset(pos), &blk, FirstSize);
   }
   void wtfirst(int pos, const Block<keyType, valueType>& blk) {
     if (pos < 0)
       exit(-1);
-    _file.seekp(pos * sizeof(Block<keyType, valueType>) + sizeof(int) * 2 + sizeof(recycle));
-    _file.write(reinterpret_cast<const char*>(&(blk.isLeaf)), sizeof(blk.isLeaf));
-    _file.write(reinterpret_cast<const char*>(&(blk.siz)), sizeof(blk.siz));
-    _file.write(reinterpret_cast<const char*>(&(blk.nxt)), sizeof(blk.nxt));
-    _file.write(reinterpret_cast<const char*>(&(blk.ele)), sizeof(blk.ele));
+    Preserve(pos);
+    _file.Write(Offset(pos), &blk, FirstSize);
   }
-  void rdsize(int pos, Block<keyType, valueType>& blk) {
+  void rdsize(int pos, Block<keyType, valueType>& blk) const {
     if (pos < 0)
       exit(-1);
-    _file.seekg(pos * sizeof(Block<keyType, valueType>) + sizeof(int) * 3 + sizeof(recycle));
-    _file.read(reinterpret_cast<char*>(&(blk.siz)), sizeof(blk.siz));
+    _file.Read(Offset(pos) + offsetof(BlockType, siz), &blk.siz, sizeof(blk.siz));
   }
   void wtsize(int pos, const Block<keyType, valueType>& blk) {
     if (pos < 0)
       exit(-1);
-    _file.seekp(pos * sizeof(Block<keyType, valueType>) + sizeof(int) * 3 + sizeof(recycle));
-    _file.write(reinterpret_cast<const char*>(&(blk.siz)), sizeof(blk.siz));
+    Preserve(pos);
+    _file.Write(Offset(pos) + offsetof(BlockType, siz), &blk.siz, sizeof(blk.siz));
+  }
+
+  // 旧块，key是块号，RootKey存旧的root
+  VersionStore versions;
+  static const int RootKey = -1;
+  // 这次写第一次碰这个块：有快照在看的话先存下整块旧内容
+  void Preserve(int pos) {
+    long long v = snapshots.SaveVersion();
+    if (!v || versions.Saved(pos, v, 0, sizeof(BlockType)))
+      return;
+    char* old = static_cast<char*>(malloc(sizeof(BlockType)));
+    _file.Read(Offset(pos), old, sizeof(BlockType));
+    versions.Save(pos, v, 0, sizeof(BlockType), old);
+  }
+  void SetRoot(int r) {
+    long long v = snapshots.SaveVersion();
+    if (v && !versions.Saved(RootKey, v, 0, sizeof(int))) {
+      char* old = static_cast<char*>(malloc(sizeof(int)));
+      int cur = root;
+      memcpy(old, &cur, sizeof(int));
+      versions.Save(RootKey, v, 0, sizeof(int), old);
+    }
+    root = r;
+  }
+  // 快照s下的块
+  void ReadAt(int pos, Block<keyType, valueType>& blk, size_t n, long long s) const {
+    _file.Read(Offset(pos), &blk, n);
+    versions.Overlay(pos, s, &blk, n);
   }
 
-  int last = -1;
-  int GetPos() {
+  mutable LatchTable latches;
+  mutable std::shared_mutex rootLatch;  // 保护root本身
+  std::mutex allocLatch;                // 保护nowsize和recycle
+
+  static const int MaxDepth = 32;
+  // 一次写操作的上下文，原来的成员pass/last挪到这里
+  struct WriteContext {
+    Element<keyType, valueType> pass;  // 裂块时交给父亲的元素
+    int last = -1;                     // 本次操作最后分配的块
+    int rootPos = -1;                  // 开始时的根
+    bool rootLocked = false;           // 是否还持有rootLatch
+    int held[MaxDepth];                // 持有写锁的块，从上到下
+    int heldCnt = 0;
+  };
+
+  int GetPos(WriteContext& ctx) {
+    std::lock_guard<std::mutex> guard(allocLatch);
     if (recycle[0]) {
       int ret = recycle[recycle[0]--];
-      last = ret;
+      ctx.last = ret;
       return ret;
     }
-    last = (++nowsize);
+    ctx.last = (++nowsize);
     return nowsize;
   }
-  inline int LastPos() {
-    return last;
+  inline int LastPos(const WriteContext& ctx) {
+    return ctx.last;
   }
   inline void Recycle(int num) {
+    std::lock_guard<std::mutex> guard(allocLatch);
     recycle[++recycle[0]] = num;
   }
 
-  Element<keyType, valueType> pass;
-  bool InternalInsert(Block<keyType, valueType>& cur, int pos, const Element<keyType, valueType>& ele) {
+  // 给孩子加写锁
+  void LockChild(WriteContext& ctx, int pos) {
+    latches[pos].lock();
+    ctx.held[ctx.heldCnt++] = pos;
+  }
+  // 最下面的块是安全的：放掉它上面所有的锁
+  void ReleaseAncestors(WriteContext& ctx) {
+    if (ctx.rootLocked) {
+      rootLatch.unlock();
+      ctx.rootLocked = false;
+    }
+    for (int i = 0; i + 1 < ctx.heldCnt; ++i)
+      latches[ctx.held[i]].unlock();
+    ctx.held[0] = ctx.held[ctx.heldCnt - 1];
+    ctx.heldCnt = 1;
+  }
+  void ReleaseAll(WriteContext& ctx) {
+    if (ctx.rootLocked) {
+      rootLatch.unlock();
+      ctx.rootLocked = false;
+    }
+    for (int i = 0; i < ctx.heldCnt; ++i)
+      latches[ctx.held[i]].unlock();
+    ctx.heldCnt = 0;
+  }
+  // 插一个元素不会裂开
+  static bool InsertSafe(const Block<keyType, valueType>& blk) {
+    return blk.siz < MaxSize;
+  }
+  // 删一个元素不会并块
+  static bool RemoveSafe(const Block<keyType, valueType>& blk) {
+    return blk.siz > MinSize;
+  }
+
+  // 调用时已经持有pos的写锁
+  bool InternalInsert(WriteContext& ctx, Block<keyType, valueType>& cur, int pos, const Element<keyType, valueType>& ele) {
     // 注意比最后一个元素大要不要特判
     if (cur.isLeaf) {
       int l = 0, r = cur.siz;
@@ -180,8 +306,8 @@ class BPTree {
       }
       ++cur.siz;
       cur.ele[l] = ele;
-      int newpos = GetPos();
-      static Block<keyType, valueType> blk;
+      int newpos = GetPos(ctx);
+      Block<keyType, valueType> blk;
       blk.isLeaf = true;
       blk.siz = MinSize + 1;
       blk.nxt = cur.nxt;
@@ -190,8 +316,9 @@ class BPTree {
         blk.ele[i] = cur.ele[i + MinSize];
       }
       cur.siz = MinSize;
-      if (root == pos) {
-        static Block<keyType, valueType> newroot;
+      if (pos == ctx.rootPos) {
+        // 根不安全，rootLatch一直拿着
+        Block<keyType, valueType> newroot;
         newroot.isLeaf = false;
         newroot.siz = 1;
         newroot.ele[0] = cur.ele[MinSize];
@@ -199,14 +326,14 @@ class BPTree {
         newroot.chd[1] = newpos;
         wtfirst(pos, cur);
         wtfirst(newpos, blk);
-        int rootpos = GetPos();
+        int rootpos = GetPos(ctx);
         wtall(rootpos, newroot);
-        root = rootpos;
+        SetRoot(rootpos);
         return false;
       }
       wtall(pos, cur);
       wtall(newpos, blk);
-      pass = blk.ele[0];
+      ctx.pass = blk.ele[0];
       return true;  // 调整
     }
 
@@ -225,8 +352,11 @@ class BPTree {
     }
     // 就是 l
     Block<keyType, valueType> child;
+    LockChild(ctx, cur.chd[l]);
     rdall(cur.chd[l], child);
-    bool state = InternalInsert(child, cur.chd[l], ele);
+    if (InsertSafe(child))
+      ReleaseAncestors(ctx);  // 孩子不会裂，cur不会再被改
+    bool state = InternalInsert(ctx, child, cur.chd[l], ele);
     if (!state)
       return false;
 
@@ -236,8 +366,8 @@ class BPTree {
         cur.chd[i + 2] = cur.chd[i + 1];
       }
       ++cur.siz;
-      cur.ele[l] = pass;
-      cur.chd[l + 1] = LastPos();
+      cur.ele[l] = ctx.pass;
+      cur.chd[l + 1] = LastPos(ctx);
       wtall(pos, cur);
       return false;
     }
@@ -247,11 +377,11 @@ class BPTree {
       cur.chd[i + 2] = cur.chd[i + 1];
     }
     ++cur.siz;
-    cur.ele[l] = pass;
-    cur.chd[l + 1] = LastPos();
-    int newpos = GetPos();
-    pass = cur.ele[MinSize];
-    static Block<keyType, valueType> blk;
+    cur.ele[l] = ctx.pass;
+    cur.chd[l + 1] = LastPos(ctx);
+    int newpos = GetPos(ctx);
+    ctx.pass = cur.ele[MinSize];
+    Block<keyType, valueType> blk;
     blk.isLeaf = false;
     blk.siz = MinSize;
     for (int i = 0; i < MinSize; ++i) {
@@ -260,19 +390,19 @@ class BPTree {
     }
     blk.chd[MinSize] = cur.chd[cur.siz];
     cur.siz = MinSize;
-    if (root == pos) {
+    if (pos == ctx.rootPos) {
       // 裂根
-      static Block<keyType, valueType> newroot;
+      Block<keyType, valueType> newroot;
       newroot.isLeaf = false;
       newroot.siz = 1;
-      newroot.ele[0] = pass;
+      newroot.ele[0] = ctx.pass;
       newroot.chd[0] = pos;
       newroot.chd[1] = newpos;
       wtall(pos, cur);
       wtall(newpos, blk);
-      int rootpos = GetPos();
+      int rootpos = GetPos(ctx);
       wtall(rootpos, newroot);
-      root = rootpos;
+      SetRoot(rootpos);
       return false;
     }
     wtall(pos, cur);
@@ -280,7 +410,8 @@ class BPTree {
     return true;
   }
 
-  bool InternalRemove(Block<keyType, valueType>& cur, int pos, const Element<keyType, valueType>& ele) {
+  // 调用时已经持有pos的写锁
+  bool InternalRemove(WriteContext& ctx, Block<keyType, valueType>& cur, int pos, const Element<keyType, valueType>& ele) {
     if (cur.isLeaf) {
       int l = 0, r = cur.siz;
       while (l < r) {
@@ -299,7 +430,7 @@ class BPTree {
         cur.ele[i - 1] = cur.ele[i];
       }
       --cur.siz;
-      if (pos == root) {
+      if (pos == ctx.rootPos) {
         wtall(pos, cur);
       }
       wtfirst(pos, cur);
@@ -326,16 +457,21 @@ class BPTree {
     }
     // 就是 l
     Block<keyType, valueType> child;
+    LockChild(ctx, cur.chd[l]);
     rdall(cur.chd[l], child);
-    bool state = InternalRemove(child, cur.chd[l], ele);
+    if (RemoveSafe(child))
+      ReleaseAncestors(ctx);  // 孩子不会并块，cur不会再被改
+    bool state = InternalRemove(ctx, child, cur.chd[l], ele);
     if (!state)
       return false;
+    // 要借/并的兄弟：有左兄弟用左边，否则用右边，下面几种情况都只碰它
+    std::unique_lock<std::shared_mutex> siblingGuard(latches[cur.chd[l > 0 ? l - 1 : l + 1]]);
 
     // 并块！此时 child 已经删掉了一个元素，考虑跟相邻两个元素之一合并
     // 合并
     // 特判根！如果根的孩子要并块且并完只剩一个块，那么这个根消灭
-    if (pos == root && cur.siz == 1) {
-      static Block<keyType, valueType> blk[2];
+    if (pos == ctx.rootPos && cur.siz == 1) {
+      Block<keyType, valueType> blk[2];
       rdsize(cur.chd[0], blk[0]);
       rdsize(cur.chd[1], blk[1]);
       if (blk[0].siz + blk[1].siz < MaxSize) {
@@ -350,7 +486,7 @@ class BPTree {
           }
           blk[0].siz += blk[1].siz;
           blk[0].nxt = blk[1].nxt;
-          root = cur.chd[0];
+          SetRoot(cur.chd[0]);
           wtfirst(cur.chd[0], blk[0]);
           return false;
         }
@@ -361,14 +497,14 @@ class BPTree {
         blk[0].chd[blk[0].siz + blk[1].siz + 1] = blk[1].chd[blk[1].siz];
         blk[0].ele[blk[0].siz] = cur.ele[0];
         blk[0].siz += blk[1].siz + 1;
-        root = cur.chd[0];
+        SetRoot(cur.chd[0]);
         wtall(cur.chd[0], blk[0]);
         return false;
       }
     }
     if (l > 0) {
       // 考虑和左边借元素 / 合并
-      static Block<keyType, valueType> blk;
+      Block<keyType, valueType> blk;
       rdsize(cur.chd[l - 1], blk);
       if (blk.siz > MinSize) {
         // 从左边借一个
@@ -444,7 +580,7 @@ class BPTree {
       return false;
     } else if (l < cur.siz) {
       // 和右边借元素 / 合并
-      static Block<keyType, valueType> blk;
+      Block<keyType, valueType> blk;
       rdsize(cur.chd[l + 1], blk);
       if (blk.siz > MinSize) {
         // 从右边借一个
@@ -523,130 +659,221 @@ class BPTree {
     }
   }
 
- public:
-  int root = -1;
-  BPTree() = default;
-  explicit BPTree(const std::string& name) {
-    _filename = name;
-    _file.open(_filename);
-    if (!_file) {
-      // 文件不存在，创建新文件
-      _file.open(_filename, std::fstream::out);
-      _file.close();
-      _file.open(_filename);
-      nowsize = -1;
-      _file.seekp(0);
-      _file.write(reinterpret_cast<const char*>(&nowsize), sizeof(nowsize));
-      root = -1;
-      _file.write(reinterpret_cast<const char*>(&root), sizeof(root));
-      recycle[0] = 0;
-      _file.write(reinterpret_cast<const char*>(&recycle), sizeof(recycle));
-      static Block<keyType, valueType> tmp;
-      _file.write(reinterpret_cast<const char*>(&tmp), sizeof(tmp));
-    } else {
-      _file.seekg(0);
-      _file.read(reinterpret_cast<char*>(&nowsize), sizeof(nowsize));
-      _file.read(reinterpret_cast<char*>(&root), sizeof(root));
-      _file.read(reinterpret_cast<char*>(&recycle), sizeof(recycle));
+  // 第一个key<=ele[l].key的位置
+  static int LowerBound(const Block<keyType, valueType>& blk, const keyType& key) {
+    int l = 0, r = blk.siz;
+    while (l < r) {
+      int mid = (l + r) >> 1;
+      if (key <= blk.ele[mid].key) {
+        r = mid;
+      } else {
+        l = mid + 1;
+      }
     }
+    return l;
   }
-  ~BPTree() {
-    _file.seekp(0);
-    _file.write(reinterpret_cast<const char*>(&nowsize), sizeof(nowsize));
-    _file.write(reinterpret_cast<const char*>(&root), sizeof(root));
-    _file.write(reinterpret_cast<const char*>(&recycle), sizeof(recycle));
-    _file.close();
+  // 在叶子里收集key的、keep为真的值，返回是否已经扫到了比key大的元素或者stop为真的值（不用再往右走）
+  template <class A, class Keep, class Stop>
+  static bool CollectLeaf(const Block<keyType, valueType>& blk, int l, const keyType& key, vector<valueType, A>& res, Keep& keep, Stop& stop) {
+    for (int i = l; i < blk.siz; ++i) {
+      if (key < blk.ele[i].key || (key == blk.ele[i].key && stop(blk.ele[i].val)))
+        return true;
+      if (key == blk.ele[i].key && keep(blk.ele[i].val))
+        res.push_back(blk.ele[i].val);
+    }
+    return false;
+  }
+  // 叶子里第一个可能等于key的位置，-1表示叶子里肯定没有
+  static int LeafStart(const Block<keyType, valueType>& blk, const keyType& key) {
+    int l = LowerBound(blk, key);
+    if (l > 0)
+      --l;
+    if (l < blk.siz && key < blk.ele[l].key)
+      return -1;
+    return l;
   }
 
-  void Find(const keyType& key, vector<valueType>& res) {
+  // 一次查找，叶子链上加锁失败返回false，调用者从根重来
+  template <class A, class Keep, class Stop>
+  bool TryFind(const keyType& key, vector<valueType, A>& res, Block<keyType, valueType>& cur, Keep& keep, Stop& stop) const {
     res.clear();
+    std::shared_lock<std::shared_mutex> rootGuard(rootLatch);
     if (root == -1)
-      return;
-
-    static Block<keyType, valueType> cur;
-    cur.isLeaf = false;
+      return true;
     int pos = root;
+    latches[pos].lock_shared();
+    rootGuard.unlock();
     while (true) {
       rdall(pos, cur);
       if (cur.isLeaf) {
         break;
       }
-      // 二分
-      int l = 0, r = cur.siz;
-      while (l < r) {
-        int mid = (l + r) >> 1;
-        if (key <= cur.ele[mid].key) {
-          r = mid;
-        } else {
-          l = mid + 1;
-        }
-      }
-      // 就是 l
+      // 就是 l，先锁孩子再放自己
+      int l = LowerBound(cur, key);
+      latches[cur.chd[l]].lock_shared();
+      latches[pos].unlock_shared();
       pos = cur.chd[l];
     }
 
-    int l = 0, r = cur.siz;
-    while (l < r) {
-      int mid = (l + r) >> 1;
-      if (key <= cur.ele[mid].key) {
-        r = mid;
-      } else {
-        l = mid + 1;
+    int l = LeafStart(cur, key);
+    if (l < 0) {
+      latches[pos].unlock_shared();
+      return true;
+    }
+    while (!CollectLeaf(cur, l, key, res, keep, stop)) {
+      int nxt = cur.nxt;
+      if (nxt == -1)
+        break;
+      // 写者可能拿着右边的叶子等左边，这里不能等
+      if (!latches[nxt].try_lock_shared()) {
+        latches[pos].unlock_shared();
+        return false;
       }
+      latches[pos].unlock_shared();
+      pos = nxt;
+      rdfirst(pos, cur);
+      l = 0;
     }
-    if (l > 0)
-      --l;
-    // l 为第一个可能值
-    if (l < cur.siz && key < cur.ele[l].key)
-      return;
+    latches[pos].unlock_shared();
+    return true;
+  }
 
-    bool flag = false;
+  // 快照s下的查找，不加锁，也不会被写者挡住
+  template <class A, class Keep, class Stop>
+  void FindAt(const keyType& key, vector<valueType, A>& res, long long s, Keep& keep, Stop& stop) const {
+    res.clear();
+    int pos = root;
+    versions.Overlay(RootKey, s, &pos, sizeof(pos));
+    if (pos == -1)
+      return;
+    Block<keyType, valueType> cur;
     while (true) {
-      for (int i = l; i < cur.siz; ++i) {
-        if (key < cur.ele[i].key) {
-          flag = true;
-          break;
-        }
-        if (key == cur.ele[i].key)
-          res.push_back(cur.ele[i].val);
-      }
-      if (flag)
+      ReadAt(pos, cur, sizeof(cur), s);
+      if (cur.isLeaf)
         break;
+      pos = cur.chd[LowerBound(cur, key)];
+    }
+    int l = LeafStart(cur, key);
+    if (l < 0)
+      return;
+    while (!CollectLeaf(cur, l, key, res, keep, stop)) {
       pos = cur.nxt;
       if (pos == -1)
         break;
-      rdfirst(pos, cur);
+      ReadAt(pos, cur, FirstSize, s);
       l = 0;
     }
   }
 
+ public:
+  std::atomic<int> root{-1};
+  BPTree() = default;
+  explicit BPTree(const std::string& name) {
+    _filename = name;
+    if (!_file.Open(_filename)) {
+      // 文件不存在，创建新文件
+      nowsize = -1;
+      root = -1;
+      recycle[0] = 0;
+      WriteHeader();
+      Block<keyType, valueType>* tmp = new Block<keyType, valueType>();
+      _file.Write(Offset(0), tmp, sizeof(*tmp));
+      delete tmp;
+    } else {
+      _file.Read(0, &nowsize, sizeof(nowsize));
+      int r;
+      _file.Read(sizeof(int), &r, sizeof(r));
+      root = r;
+      _file.Read(sizeof(int) * 2, &recycle, sizeof(recycle));
+    }
+  }
+  ~BPTree() {
+    WriteHeader();
+    _file.Close();
+  }
+  void WriteHeader() {
+    _file.Write(0, &nowsize, sizeof(nowsize));
+    int r = root;
+    _file.Write(sizeof(int), &r, sizeof(r));
+    _file.Write(sizeof(int) * 2, &recycle, sizeof(recycle));
+  }
+
+  // 只读，可以和其他Find/Insert/Remove同时调用；当前线程拿着快照时读快照
+  // res可以是普通的vector，也可以是指令内的TempVector
+  template <class A>
+  void Find(const keyType& key, vector<valueType, A>& res) const {
+    Find(key, res, [](const valueType&) { return true; }, [](const valueType&) { return false; });
+  }
+  /*
+  只收keep(val)为真的值
+  * 同一个key的值按valueType的顺序排，stop(val)为真说明这个值和之后的都不要了，后面的叶子不再读
+  * stop要和值的顺序一致：一旦为真，之后的值也都为真
+  */
+  template <class A, class Keep, class Stop>
+  void Find(const keyType& key, vector<valueType, A>& res, Keep keep, Stop stop) const {
+    PhaseScope phase(PHASE_INDEX, "BPTree::Find");
+    if (readSnapshot) {
+      FindAt(key, res, readSnapshot, keep, stop);
+      return;
+    }
+    Block<keyType, valueType> cur;
+    while (!TryFind(key, res, cur, keep, stop))
+      std::this_thread::yield();  // 叶子链上撞到了写者，从根重来
+  }
+
   void Insert(const Element<keyType, valueType>& ele) {
+    PhaseScope phase(PHASE_INDEX, "BPTree::Insert");
+    WriteContext ctx;
+    rootLatch.lock();
+    ctx.rootLocked = true;
     if (root == -1) {
-      root = nowsize = 0;
-      static Block<keyType, valueType> cur;
+      {
+        std::lock_guard<std::mutex> guard(allocLatch);
+        nowsize = 0;
+      }
+      SetRoot(0);
+      Block<keyType, valueType> cur;
       cur.siz = 1;
       cur.ele[0] = ele;
       cur.isLeaf = true;
       cur.nxt = -1;
-      wtfirst(nowsize, cur);
+      wtfirst(root, cur);
+      ReleaseAll(ctx);
       return;
     }
+    ctx.rootPos = root;
     Block<keyType, valueType> cur;
-    rdall(root, cur);
-    InternalInsert(cur, root, ele);
+    LockChild(ctx, ctx.rootPos);
+    rdall(ctx.rootPos, cur);
+    if (InsertSafe(cur))
+      ReleaseAncestors(ctx);  // 根不会裂，root不会变
+    InternalInsert(ctx, cur, ctx.rootPos, ele);
+    ReleaseAll(ctx);
   }
 
   void Remove(const Element<keyType, valueType>& ele) {
-    if (root == -1)
+    PhaseScope phase(PHASE_INDEX, "BPTree::Remove");
+    WriteContext ctx;
+    rootLatch.lock();
+    ctx.rootLocked = true;
+    if (root == -1) {
+      ReleaseAll(ctx);
       return;
-    static Block<keyType, valueType> cur;
-    rdall(root, cur);
-    InternalRemove(cur, root, ele);
+    }
+    ctx.rootPos = root;
+    Block<keyType, valueType> cur;
+    LockChild(ctx, ctx.rootPos);
+    rdall(ctx.rootPos, cur);
+    if (cur.isLeaf || cur.siz > 1)
+      ReleaseAncestors(ctx);  // 根至少还剩一个元素，root不会变
+    InternalRemove(ctx, cur, ctx.rootPos, ele);
+    ReleaseAll(ctx);
   }
 
+  // 不能和其他操作同时调用
   void Clear() {
     nowsize = -1;
-    root = -1;
+    SetRoot(-1);
     recycle[0] = 0;
   }
 };
@@ -0,0 +1,169 @@
+#ifndef SJTU_FILE_HPP
+#define SJTU_FILE_HPP
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+#include "vector.hpp"
+
+namespace sjtu {
+
+/*
+I/O记账
+* 每个文件按“当前在执行的指令”分别计数：读次数、写次数、读写字节数、seek次数
+* 用的是pread/pwrite，没有真的seek；这次访问的起点不是这个文件上一次访问的终点就算一次seek
+* ioCommand由Executor在执行每条指令时设置（下标是CommandType），IoIdle表示不在执行指令，比如启动和退出落盘
+* 计数是relaxed原子变量，并发的查询线程各自累加
+*/
+const int IoSlots = 32;
+const int IoIdle = IoSlots - 1;
+thread_local int ioCommand = IoIdle;
+
+struct IoCounter {
+  std::atomic<uint64_t> reads{0}, writes{0}, readBytes{0}, writeBytes{0}, seeks{0};
+
+  void Reset() {
+    reads = writes = readBytes = writeBytes = seeks = 0;
+  }
+  bool Empty() const {
+    return !reads && !writes;
+  }
+};
+
+class File;
+
+// 所有打开的文件，导出I/O计数时遍历
+class FileRegistry {
+ private:
+  std::mutex m;
+  vector<File*> files;
+
+ public:
+  void Register(File* f) {
+    std::lock_guard<std::mutex> lk(m);
+    files.push_back(f);
+  }
+  void Unregister(File* f) {
+    std::lock_guard<std::mutex> lk(m);
+    for (size_t i = 0; i < files.size(); ++i)
+      if (files[i] == f) {
+        files[i] = files[files.size() - 1];
+        files.pop_back();
+        return;
+      }
+  }
+  template <class F>
+  void ForEach(F fn) {
+    std::lock_guard<std::mutex> lk(m);
+    for (size_t i = 0; i < files.size(); ++i)
+      fn(*files[i]);
+  }
+};
+FileRegistry openFiles;
+
+/*
+数据文件
+* 用pread/pwrite按偏移读写，没有共享的文件指针，多个线程同时读是安全的
+* 读到文件末尾以外的部分补0
+*/
+class File {
+ private:
+  int fd = -1;
+  std::string _filename;
+  IoCounter io[IoSlots];
+  mutable std::atomic<long long> lastEnd{-1};
+
+  void Account(bool write, long long pos, size_t n) const {
+    IoCounter& c = const_cast<IoCounter&>(io[ioCommand]);
+    if (write) {
+      c.writes.fetch_add(1, std::memory_order_relaxed);
+      c.writeBytes.fetch_add(n, std::memory_order_relaxed);
+    } else {
+      c.reads.fetch_add(1, std::memory_order_relaxed);
+      c.readBytes.fetch_add(n, std::memory_order_relaxed);
+    }
+    if (lastEnd.exchange(pos + n, std::memory_order_relaxed) != pos)
+      c.seeks.fetch_add(1, std::memory_order_relaxed);
+  }
+
+ public:
+  File() = default;
+  File(const File&) = delete;
+  File& operator=(const File&) = delete;
+  ~File() {
+    Close();
+  }
+
+  // 打开文件，不存在则创建，返回打开前文件是否已经存在
+  bool Open(const std::string& name) {
+    Close();
+    _filename = name;
+    fd = open(name.c_str(), O_RDWR);
+    bool existed = fd >= 0;
+    if (!existed)
+      fd = open(name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd >= 0)
+      openFiles.Register(this);
+    return existed;
+  }
+  void Close() {
+    if (fd < 0)
+      return;
+    close(fd);
+    fd = -1;
+    openFiles.Unregister(this);
+  }
+  bool IsOpen() const {
+    return fd >= 0;
+  }
+  const std::string& Name() const {
+    return _filename;
+  }
+  // 第k类指令在这个文件上的I/O计数
+  const IoCounter& Counter(int k) const {
+    return io[k];
+  }
+  void ResetCounters() {
+    for (int k = 0; k < IoSlots; ++k)
+      io[k].Reset();
+  }
+
+  void Read(long long pos, void* p, size_t n) const {
+    Account(false, pos, n);
+    char* dst = static_cast<char*>(p);
+    while (n) {
+      ssize_t got = pread(fd, dst, n, pos);
+      if (got <= 0) {
+        memset(dst, 0, n);
+        return;
+      }
+      dst += got, pos += got, n -= got;
+    }
+  }
+  void Write(long long pos, const void* p, size_t n) {
+    Account(true, pos, n);
+    const char* src = static_cast<const char*>(p);
+    while (n) {
+      ssize_t put = pwrite(fd, src, n, pos);
+      if (put <= 0)
+        return;
+      src += put, pos += put, n -= put;
+    }
+  }
+  // 截断到size字节，之后超出的部分读出来是0
+  void Truncate(long long size) {
+    if (ftruncate(fd, size) != 0)
+      perror(_filename.c_str());
+  }
+};
+
+}  // namespace sjtu
+
+#endif  // !SJTU_FILE_HPP
@@ -0,0 +1,455 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "vector.hpp"
+#include "writer.hpp"
+
+// 合成负载生成器：按种子确定性地生成用户、车站、车次和指令流，输出和现有用例同格式的trace
+// gen_trace [--选项 值]... > x.in
+// * 同样的参数和种子，输出逐字节相同（自带PRNG，不依赖标准库的随机数实现）
+// * 车站按Zipf分布挑选，少数枢纽站出现在很多车次上，用来复现QueryTransfer的规模悬崖
+// * 先建用户、车次并发布，再按比例混合各种指令，最后exit
+// 选项（括号里是默认值）：
+//   --seed (1) --users (1000) --trains (200) --stations (500)
+//   --min-stops (5) --max-stops (30)    每趟车的站数
+//   --sale-days (30)                     售票窗口天数，1~92
+//   --zipf (1.0)                         枢纽倾斜度，0表示均匀
+//   --seats (1000) --commands (100000)   混合阶段的指令条数
+//   --release (0.9)                      发布车次的比例
+//   --hit (0.8)                          查询/购票的起终点取自同一趟车的概率
+//   --queue (0.3)                        余票不足时愿意候补的概率
+//   各类指令的权重：--query (40) --transfer (2) --buy (25) --refund (5)
+//                   --order (8) --profile (5) --train (5) --relogin (2)
+
+namespace {
+
+// splitmix64，够快、统计性质够用，关键是跨平台结果一致
+class Rng {
+ private:
+  uint64_t s;
+
+ public:
+  explicit Rng(uint64_t seed)
+      : s(seed) {}
+  uint64_t Next() {
+    uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+  // [0,n)
+  int Below(int n) {
+    return static_cast<int>(Next() % static_cast<uint64_t>(n));
+  }
+  // [lo,hi]
+  int Range(int lo, int hi) {
+    return lo + Below(hi - lo + 1);
+  }
+  // [0,1)
+  double Unit() {
+    return (Next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+  bool Chance(double p) {
+    return Unit() < p;
+  }
+};
+
+// 下标i被选中的概率正比于1/(i+1)^s，预先算好累积分布，二分查找
+class Zipf {
+ private:
+  sjtu::vector<double> cdf;
+
+ public:
+  Zipf(int n, double s) {
+    double sum = 0;
+    for (int i = 0; i < n; ++i) {
+      sum += 1.0 / pow(i + 1, s);
+      cdf.push_back(sum);
+    }
+    for (int i = 0; i < n; ++i)
+      cdf[i] /= sum;
+  }
+  int Sample(Rng& rng) const {
+    double u = rng.Unit();
+    int l = 0, r = cdf.size() - 1;
+    while (l < r) {
+      int mid = (l + r) >> 1;
+      if (cdf[mid] < u)
+        l = mid + 1;
+      else
+        r = mid;
+    }
+    return l;
+  }
+};
+
+struct Options {
+  uint64_t seed = 1;
+  int users = 1000, trains = 200, stations = 500;
+  int minStops = 5, maxStops = 30;
+  int saleDays = 30, seats = 1000, commands = 100000;
+  double zipf = 1.0, release = 0.9, hit = 0.8, queue = 0.3;
+  // 权重的顺序和Mix一致
+  int weight[8] = {40, 2, 25, 5, 8, 5, 5, 2};
+};
+enum Mix { MIX_QUERY = 0, MIX_TRANSFER, MIX_BUY, MIX_REFUND, MIX_ORDER, MIX_PROFILE, MIX_TRAIN, MIX_RELOGIN, MIX_COUNT };
+const char* const MixFlags[MIX_COUNT] = {"--query", "--transfer", "--buy", "--refund", "--order", "--profile", "--train", "--relogin"};
+
+struct Train {
+  sjtu::vector<int> stops;  // 车站编号
+  sjtu::vector<int> days;   // 从始发站出发那天算起，第几天离开这一站
+  int firstDay;             // 售票窗口第一天，从6月1日算起
+  bool released;
+};
+
+const int SummerDays = 92;  // 6月1日到8月31日
+
+// 6月1日之后第k天，写成MM-DD
+void PutDate(sjtu::Writer& w, int k) {
+  int month = 6;
+  const int len[3] = {30, 31, 31};
+  while (k >= len[month - 6])
+    k -= len[month - 6], ++month;
+  w.put2(month);
+  w << '-';
+  w.put2(k + 1);
+}
+
+// 车站名：两个音节拼起来，超过音节组合数再带上序号
+const char* const Syllables[32] = {"an", "bei", "cheng", "da", "dong", "fu", "guang", "hai", "he", "hu", "jiang", "jin", "kai", "lin", "long", "nan", "ning", "ping", "qing", "shan", "shi", "tai", "tian", "wu", "xi", "xin", "yang", "yuan", "zhang", "zhou", "zhu", "feng"};
+void PutStation(sjtu::Writer& w, int id) {
+  w << Syllables[id % 32] << Syllables[(id / 32) % 32];
+  if (id >= 32 * 32)
+    w << id / (32 * 32);
+}
+
+class Generator {
+ private:
+  const Options& opt;
+  Rng rng;
+  Zipf hubs;
+  sjtu::Writer& out;
+  long long stamp = 0;
+  sjtu::vector<Train> trains;
+  sjtu::vector<int> orders;  // 每个用户已经下的单数
+  sjtu::vector<char> online;
+
+  void Begin(const char* name) {
+    out << '[' << ++stamp << "] " << name;
+  }
+  void PutUser(int u) {
+    out << 'u' << u;
+  }
+
+  // 不重复地按Zipf挑k个车站；枢纽站不够挑时退回均匀
+  void PickStops(int k, sjtu::vector<int>& stops) {
+    sjtu::vector<char> used;
+    for (int i = 0; i < opt.stations; ++i)
+      used.push_back(0);
+    int tries = 0;
+    while (static_cast<int>(stops.size()) < k) {
+      int s = tries < k * 20 ? hubs.Sample(rng) : rng.Below(opt.stations);
+      ++tries;
+      if (used[s])
+        continue;
+      used[s] = 1;
+      stops.push_back(s);
+    }
+  }
+
+  void AddUser(int u) {
+    Begin("add_user");
+    out << " -c ";
+    PutUser(0);
+    out << " -u ";
+    PutUser(u);
+    out << " -p pw" << u << " -n name" << u << " -m u" << u << "@example.com -g " << (u ? rng.Range(0, 9) : 10) << '\n';
+  }
+  void Login(int u) {
+    Begin("login");
+    out << " -u ";
+    PutUser(u);
+    out << " -p pw" << u << '\n';
+    online[u] = 1;
+  }
+
+  void AddTrain(int t) {
+    Train& tr = trains[t];
+    int k = rng.Range(opt.minStops, opt.maxStops);
+    PickStops(k, tr.stops);
+    int start = rng.Range(0, 23) * 60 + rng.Range(0, 11) * 5;
+    int minutes = start;
+    Begin("add_train");
+    out << " -i T" << t << " -n " << k << " -m " << opt.seats << " -s ";
+    for (int i = 0; i < k; ++i) {
+      if (i)
+        out << '|';
+      PutStation(out, tr.stops[i]);
+    }
+    out << " -p ";
+    for (int i = 0; i + 1 < k; ++i)
+      out << (i ? "|" : "") << rng.Range(10, 500);
+    out << " -x ";
+    out.put2(start / 60);
+    out << ':';
+    out.put2(start % 60);
+    out << " -t ";
+    tr.days.push_back(0);
+    sjtu::vector<int> stopover;
+    for (int i = 0; i + 1 < k; ++i) {
+      int travel = rng.Range(30, 600);
+      out << (i ? "|" : "") << travel;
+      minutes += travel;
+      if (i + 2 < k) {
+        stopover.push_back(rng.Range(2, 20));
+        minutes += stopover.back();
+        tr.days.push_back(minutes / 1440);
+      }
+    }
+    tr.days.push_back(minutes / 1440);  // 终点站只到不发，占个位
+    out << " -o ";
+    if (stopover.empty())
+      out << '_';
+    for (size_t i = 0; i < stopover.size(); ++i)
+      out << (i ? "|" : "") << stopover[i];
+    tr.firstDay = rng.Range(0, SummerDays - opt.saleDays);
+    out << " -d ";
+    PutDate(out, tr.firstDay);
+    out << '|';
+    PutDate(out, tr.firstDay + opt.saleDays - 1);
+    out << " -y " << static_cast<char>('A' + rng.Below(26)) << '\n';
+  }
+
+  // 挑一段行程：hit时取同一趟已发布的车上的两站，否则两个Zipf车站
+  // 返回车次编号，没有对应车次时返回-1；day是从from出发的日期
+  int PickTrip(int& from, int& to, int& day) {
+    if (rng.Chance(opt.hit)) {
+      int t = rng.Below(trains.size());
+      const Train& tr = trains[t];
+      int i = rng.Below(tr.stops.size() - 1);
+      int j = rng.Range(i + 1, tr.stops.size() - 1);
+      from = tr.stops[i], to = tr.stops[j];
+      day = tr.firstDay + rng.Below(opt.saleDays) + tr.days[i];
+      if (day >= SummerDays)
+        day = SummerDays - 1;
+      return t;
+    }
+    from = hubs.Sample(rng);
+    do
+      to = hubs.Sample(rng);
+    while (to == from && opt.stations > 1);
+    day = rng.Below(SummerDays);
+    return -1;
+  }
+  int OnlineUser() {
+    int u = rng.Below(opt.users);
+    if (!online[u])
+      Login(u);
+    return u;
+  }
+
+  void QueryTicket(const char* name) {
+    int from, to, day;
+    PickTrip(from, to, day);
+    Begin(name);
+    out << " -s ";
+    PutStation(out, from);
+    out << " -t ";
+    PutStation(out, to);
+    out << " -d ";
+    PutDate(out, day);
+    out << " -p " << (rng.Chance(0.5) ? "time" : "cost") << '\n';
+  }
+  void BuyTicket() {
+    int from, to, day;
+    int t = PickTrip(from, to, day);
+    if (t < 0)
+      t = rng.Below(trains.size());
+    int u = OnlineUser();
+    Begin("buy_ticket");
+    out << " -u ";
+    PutUser(u);
+    out << " -i T" << t << " -d ";
+    PutDate(out, day);
+    out << " -n " << rng.Range(1, opt.seats / 10 + 1) << " -f ";
+    PutStation(out, from);
+    out << " -t ";
+    PutStation(out, to);
+    out << " -q " << (rng.Chance(opt.queue) ? "true" : "false") << '\n';
+    ++orders[u];
+  }
+  void RefundTicket() {
+    int u = OnlineUser();
+    Begin("refund_ticket");
+    out << " -u ";
+    PutUser(u);
+    if (orders[u] > 1)
+      out << " -n " << rng.Range(1, orders[u]);
+    out << '\n';
+  }
+  void QueryOrder() {
+    int u = OnlineUser();
+    Begin("query_order");
+    out << " -u ";
+    PutUser(u);
+    out << '\n';
+  }
+  void QueryProfile() {
+    int u = OnlineUser();
+    Begin("query_profile");
+    out << " -c ";
+    PutUser(u);
+    out << " -u ";
+    PutUser(rng.Chance(0.5) ? u : rng.Below(opt.users));
+    out << '\n';
+  }
+  void QueryTrain() {
+    int t = rng.Below(trains.size());
+    Begin("query_train");
+    out << " -i T" << t << " -d ";
+    PutDate(out, trains[t].firstDay + rng.Below(opt.saleDays));
+    out << '\n';
+  }
+  void Relogin() {
+    int u = rng.Below(opt.users);
+    if (online[u]) {
+      Begin("logout");
+      out << " -u ";
+      PutUser(u);
+      out << '\n';
+      online[u] = 0;
+    } else {
+      Login(u);
+    }
+  }
+
+ public:
+  Generator(const Options& o, sjtu::Writer& w)
+      : opt(o), rng(o.seed), hubs(o.stations, o.zipf), out(w) {}
+
+  void Run() {
+    for (int u = 0; u < opt.users; ++u) {
+      orders.push_back(0);
+      online.push_back(0);
+    }
+    AddUser(0);
+    Login(0);
+    for (int u = 1; u < opt.users; ++u)
+      AddUser(u);
+    for (int t = 0; t < opt.trains; ++t) {
+      trains.push_back(Train());
+      AddTrain(t);
+    }
+    for (int t = 0; t < opt.trains; ++t) {
+      trains[t].released = rng.Chance(opt.release);
+      if (trains[t].released) {
+        Begin("release_train");
+        out << " -i T" << t << '\n';
+      }
+    }
+    int total = 0;
+    for (int i = 0; i < MIX_COUNT; ++i)
+      total += opt.weight[i];
+    for (int c = 0; c < opt.commands && total > 0; ++c) {
+      int r = rng.Below(total), kind = 0;
+      while (r >= opt.weight[kind])
+        r -= opt.weight[kind++];
+      switch (kind) {
+        case MIX_QUERY:
+          QueryTicket("query_ticket");
+          break;
+        case MIX_TRANSFER:
+          QueryTicket("query_transfer");
+          break;
+        case MIX_BUY:
+          BuyTicket();
+          break;
+        case MIX_REFUND:
+          RefundTicket();
+          break;
+        case MIX_ORDER:
+          QueryOrder();
+          break;
+        case MIX_PROFILE:
+          QueryProfile();
+          break;
+        case MIX_TRAIN:
+          QueryTrain();
+          break;
+        case MIX_RELOGIN:
+          Relogin();
+          break;
+      }
+      if (out.size() > (1 << 20))
+        out.flush();
+    }
+    Begin("exit");
+    out << '\n';
+    out.flush();
+  }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* key = argv[i];
+    const char* val = argv[i + 1];
+    bool known = true;
+    if (!strcmp(key, "--seed"))
+      opt.seed = strtoull(val, nullptr, 10);
+    else if (!strcmp(key, "--users"))
+      opt.users = atoi(val);
+    else if (!strcmp(key, "--trains"))
+      opt.trains = atoi(val);
+    else if (!strcmp(key, "--stations"))
+      opt.stations = atoi(val);
+    else if (!strcmp(key, "--min-stops"))
+      opt.minStops = atoi(val);
+    else if (!strcmp(key, "--max-stops"))
+      opt.maxStops = atoi(val);
+    else if (!strcmp(key, "--sale-days"))
+      opt.saleDays = atoi(val);
+    else if (!strcmp(key, "--seats"))
+      opt.seats = atoi(val);
+    else if (!strcmp(key, "--commands"))
+      opt.commands = atoi(val);
+    else if (!strcmp(key, "--zipf"))
+      opt.zipf = atof(val);
+    else if (!strcmp(key, "--release"))
+      opt.release = atof(val);
+    else if (!strcmp(key, "--hit"))
+      opt.hit = atof(val);
+    else if (!strcmp(key, "--queue"))
+      opt.queue = atof(val);
+    else {
+      known = false;
+      for (int k = 0; k < MIX_COUNT; ++k)
+        if (!strcmp(key, MixFlags[k])) {
+          opt.weight[k] = atoi(val);
+          known = true;
+        }
+    }
+    if (!known) {
+      fprintf(stderr, "unknown option %s\n", key);
+      return 2;
+    }
+  }
+  if (argc % 2 == 0) {
+    fprintf(stderr, "option %s needs a value\n", argv[argc - 1]);
+    return 2;
+  }
+  // 题面的限制：每趟车2~100站，售票窗口在6月1日到8月31日之间
+  if (opt.users < 1 || opt.trains < 1 || opt.stations < 2 || opt.minStops < 2 || opt.maxStops > 100 ||
+      opt.minStops > opt.maxStops || opt.maxStops > opt.stations || opt.saleDays < 1 || opt.saleDays > SummerDays ||
+      opt.seats < 1 || opt.commands < 0) {
+    fprintf(stderr, "invalid options\n");
+    return 2;
+  }
+  Generator gen(opt, sjtu::wout);
+  gen.Run();
+  return 0;
+}
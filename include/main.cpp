@@ -1,303 +1,80 @@
-#include "TrainSystem.hpp"
-#include "UserSystem.hpp"
-#include "bptree.hpp"
-#include "utils.hpp"
+#include <memory>
 
+#include "Executor.hpp"
+#include "Parser.hpp"
+#include "Pipeline.hpp"
+#include "Scheduler.hpp"
+#include "Server.hpp"
 #include "TicketSystem.hpp"
 
 sjtu::TicketSystem KS;
-sjtu::UserSystem& US = KS.US;
-sjtu::TrainSystem& TS = KS.TS;
-using sjtu::SplitString;
 
-// 直接把parser写在这里算了
+// parser和执行器分别在Parser.hpp和Executor.hpp里，这里只负责搬运
+// 默认走读/执行/写三段流水线，--serial 退回单线程逐行处理
+// --threads N 指定并发执行只读指令的线程数，0表示不并发
+// --server PATH 在Unix域套接字上当服务器，--tcp PORT 再监听本机TCP端口，不读标准输入
+// --slow-log PATH 把执行超过 --slow-us 微秒（默认10000）的指令连同各阶段耗时追加到PATH
+// --defer-settle 退票不立刻扫候补队列，攒到下一条不是退票的指令之前一起结算：座位全加回去再扫一遍队列（见TicketSystem）
+// --trace PATH 退出时把trace写到PATH（要用-DTICKET_TRACE=ON编译），trace_dump指令随时导出
 
-int main() {
+int main(int argc, char** argv) {
   // freopen64("in.in", "r", stdin);
   // freopen64("out.out", "w", stdout);
-  std::ios::sync_with_stdio(false);
-  cin.tie(nullptr);
-  cout.tie(nullptr);
-  sjtu::vector<string> tokens;
-  string input;
-  while (getline(cin, input)) {
-    SplitString(tokens, input, ' ');
-    cout << tokens[0] << ' ';  // timestamp
-    string& cmd = tokens[1];
-    if (cmd == "buy_ticket") {
-      string item, user, trainID, date, from, to, tp;
-      int num;
-      bool queue = false;
-      for (int i = 2; i < tokens.size(); i += 2) {
-        item = tokens[i];
-        switch (item[1]) {
-          case 'u':
-            user = tokens[i + 1];
-            break;
-          case 'i':
-            trainID = tokens[i + 1];
-            break;
-          case 'd':
-            date = tokens[i + 1];
-            break;
-          case 'n':
-            num = stoi(tokens[i + 1]);
-            break;
-          case 'f':
-            from = tokens[i + 1];
-            break;
-          case 't':
-            to = tokens[i + 1];
-            break;
-          case 'q':
-            tp = tokens[i + 1];
-            if (tp == "true")
-              queue = true;
-            else
-              queue = false;
-            break;
-        }
-      }
-      KS.BuyTicket(user, trainID, date, from, to, num, queue);
-    } else if (cmd == "query_ticket") {
-      string item, date, from, to, tp;
-      sjtu::SortType type;
-      for (int i = 2; i < tokens.size(); i += 2) {
-        item = tokens[i];
-        switch (item[1]) {
-          case 'd':
-            date = tokens[i + 1];
-            break;
-          case 's':
-            from = tokens[i + 1];
-            break;
-          case 't':
-            to = tokens[i + 1];
-            break;
-          case 'p':
-            tp = tokens[i + 1];
-            if (tp == "time")
-              type = sjtu::TIME;
-            else
-              type = sjtu::COST;
-            break;
-        }
-      }
-      KS.QueryTicket(from, to, date, type);
-    } else if (cmd == "query_profile") {
-      string item, curuser, user;
-      for (int i = 2; i < tokens.size(); i += 2) {
-        item = tokens[i];
-        switch (item[1]) {
-          case 'c':
-            curuser = tokens[i + 1];
-            break;
-          case 'u':
-            user = tokens[i + 1];
-            break;
-          default:
-            throw;
-            break;
-        }
-      }
-      US.QueryProfile(curuser, user);
-    } else if (cmd == "login") {
-      string item, user, password;
-      for (int i = 2; i < tokens.size(); i += 2) {
-        item = tokens[i];
-        switch (item[1]) {
-          case 'u':
-            user = tokens[i + 1];
-            break;
-          case 'p':
-            password = tokens[i + 1];
-            break;
-          default:
-            throw;
-            break;
-        }
-      }
-      US.Login(user, password);
-    } else if (cmd == "logout") {
-      string curuser = tokens[3];
-      US.Logout(curuser);
-    } else if (cmd == "modify_profile") {
-      string item, curuser, user, password, name, mail;
-      int privilege = -1;
-      for (int i = 2; i < tokens.size(); i += 2) {
-        item = tokens[i];
-        switch (item[1]) {
-          case 'c':
-            curuser = tokens[i + 1];
-            break;
-          case 'u':
-            user = tokens[i + 1];
-            break;
-          case 'p':
-            password = tokens[i + 1];
-            break;
-          case 'n':
-            name = tokens[i + 1];
-            break;
-          case 'm':
-            mail = tokens[i + 1];
-            break;
-          case 'g':
-            privilege = stoi(tokens[i + 1]);
-            break;
-          default:
-            throw;
-            break;
-        }
-      }
-      US.ModifyProfile(curuser, user, password, name, mail, privilege);
-    } else if (cmd == "query_order") {
-      string user = tokens[3];
-      KS.QueryOrder(user);
-    } else if (cmd == "add_user") {
-      string item, curuser, user, password, name, mail;
-      int privilege;
-      for (int i = 2; i < tokens.size(); i += 2) {
-        item = tokens[i];
-        switch (item[1]) {
-          case 'c':
-            curuser = tokens[i + 1];
-            break;
-          case 'u':
-            user = tokens[i + 1];
-            break;
-          case 'p':
-            password = tokens[i + 1];
-            break;
-          case 'n':
-            name = tokens[i + 1];
-            break;
-          case 'm':
-            mail = tokens[i + 1];
-            break;
-          case 'g':
-            privilege = stoi(tokens[i + 1]);
-            break;
-          default:
-            throw;
-            break;
-        }
-      }
-      US.AddUser(curuser, user, password, name, mail, privilege);
-    } else if (cmd == "add_train") {
-      string item, trainID, stations, prices, starttime, traveltimes, stopovertimes, salesdate;
-      int stationnum, seatnum;
-      char type;
-      for (int i = 2; i < tokens.size(); i += 2) {
-        item = tokens[i];
-        switch (item[1]) {
-          case 'i':
-            trainID = tokens[i + 1];
-            break;
-          case 'n':
-            stationnum = stoi(tokens[i + 1]);
-            break;
-          case 'm':
-            seatnum = stoi(tokens[i + 1]);
-            break;
-          case 's':
-            stations = tokens[i + 1];
-            break;
-          case 'p':
-            prices = tokens[i + 1];
-            break;
-          case 'x':
-            starttime = tokens[i + 1];
-            break;
-          case 't':
-            traveltimes = tokens[i + 1];
-            break;
-          case 'o':
-            stopovertimes = tokens[i + 1];
-            break;
-          case 'd':
-            salesdate = tokens[i + 1];
-            break;
-          case 'y':
-            type = tokens[i + 1][0];
-            break;
-          default:
-            break;
-        }
-      }
-      TS.AddTrain(trainID, stationnum, seatnum, stations, prices, starttime, traveltimes, stopovertimes, salesdate, type);
-    } else if (cmd == "delete_train") {
-      string trainID = tokens[3];
-      TS.DeleteTrain(trainID);
-    } else if (cmd == "release_train") {
-      string trainID = tokens[3];
-      TS.ReleaseTrain(trainID);
-    } else if (cmd == "query_train") {
-      string item, trainID, date;
-      for (int i = 2; i < tokens.size(); i += 2) {
-        item = tokens[i];
-        switch (item[1]) {
-          case 'i':
-            trainID = tokens[i + 1];
-            break;
-          case 'd':
-            date = tokens[i + 1];
-            break;
-          default:
-            break;
-        }
-      }
-      TS.QueryTrain(trainID, date);
+  bool serial = false;
+  const char* sock = nullptr;
+  const char* slowPath = nullptr;
+  long long slowUs = 10000;
+  int port = 0;
+  int threads = std::thread::hardware_concurrency();
+  if (threads > 8)
+    threads = 8;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--serial"))
+      serial = true;
+    else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--server") && i + 1 < argc)
+      sock = argv[++i];
+    else if (!strcmp(argv[i], "--tcp") && i + 1 < argc)
+      port = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--slow-log") && i + 1 < argc)
+      slowPath = argv[++i];
+    else if (!strcmp(argv[i], "--slow-us") && i + 1 < argc)
+      slowUs = atoll(argv[++i]);
+    else if (!strcmp(argv[i], "--defer-settle"))
+      KS.SetDeferredSettle(true);
+    else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+      sjtu::tracePath = argv[++i];
+  }
+  sjtu::Executor executor(KS);
+  // 放在executor之后构造，先于它析构，退出前把剩下的记录写完
+  std::unique_ptr<sjtu::SlowLog> slowLog;
+  if (slowPath) {
+    slowLog.reset(new sjtu::SlowLog(slowPath, slowUs * 1000));
+    if (!slowLog->IsOpen()) {
+      fprintf(stderr, "cannot open slow log %s\n", slowPath);
+      return 1;
     }
-    else if (cmd == "query_transfer") {
-      string item, date, from, to, tp;
-      sjtu::SortType type;
-      for (int i = 2; i < tokens.size(); i += 2) {
-        item = tokens[i];
-        switch (item[1]) {
-          case 'd':
-            date = tokens[i + 1];
-            break;
-          case 's':
-            from = tokens[i + 1];
-            break;
-          case 't':
-            to = tokens[i + 1];
-            break;
-          case 'p':
-            tp = tokens[i + 1];
-            if (tp == "time")
-              type = sjtu::TIME;
-            else
-              type = sjtu::COST;
-            break;
-        }
-      }
-      KS.QueryTransfer(from, to, date, type);
-    } else if (cmd == "refund_ticket") {
-      string item, user;
-      int num = 1;
-      for (int i = 2; i < tokens.size(); i += 2) {
-        item = tokens[i];
-        switch (item[1]) {
-          case 'u':
-            user = tokens[i + 1];
-            break;
-          case 'n':
-            num = stoi(tokens[i + 1]);
-            break;
-        }
-      }
-      KS.RefundTicket(user, num);
-    } else if (cmd == "clear") {
-      US.Clear();
-      TS.Clear();
-      KS.Clear();
-    } else if (cmd == "exit") {
-      cout << "bye\n";
-      break;
-    } else
-      throw;
+    executor.SetSlowLog(slowLog.get());
+  }
+  if (sock || port) {
+    sjtu::Server::BlockSignals();
+    sjtu::Scheduler scheduler(executor, threads);
+    sjtu::Server server(scheduler);
+    if ((sock && !server.ListenUnix(sock)) || (port && !server.ListenTcp(port)))
+      return 1;
+    server.Run();
+  } else if (serial) {
+    sjtu::RunSerial(0, executor);
+  } else {
+    sjtu::Scheduler scheduler(executor, threads);
+    sjtu::Pipeline pipeline(0);
+    pipeline.Run(scheduler);
   }
+  // 执行都结束了，不会再有新的记录被丢
+  if (slowLog && slowLog->Dropped())
+    fprintf(stderr, "slow log: %llu records dropped\n", (unsigned long long)slowLog->Dropped());
+  if (sjtu::tracePath && sjtu::ExportTrace(sjtu::tracePath) < 0)
+    fprintf(stderr, "trace not written: rebuild with -DTICKET_TRACE=ON, or check %s\n", sjtu::tracePath);
   return 0;
 }
@@ -0,0 +1,489 @@
+#include <chrono>
+#include <cmath>
+
+#include "TicketSystem.hpp"
+
+// 微基准：单独测容器、B+树、排序和日期时间运算，不依赖外部库
+// microbench [--reps N] [--warmup N] [--max N] [--filter 子串] [--json]
+// * 每项先跑warmup次不计，再跑reps次，每次算出 ns/op，报告最小、中位、平均、标准差、最大
+// * --max限制规模上限（排序默认测到1e6），--filter只跑名字里含这个子串的项
+// * B+树在临时目录里建文件，每次重复都是新文件
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+volatile long long sink;  // 防止被优化掉
+
+// 测一次：setup不计时，Start/Stop之间的才算
+class Timer {
+ private:
+  Clock::time_point begin;
+  long long total = 0;
+
+ public:
+  void Start() {
+    begin = Clock::now();
+  }
+  void Stop() {
+    total += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+  }
+  long long Nanos() const {
+    return total;
+  }
+};
+
+class Rng {
+ private:
+  unsigned long long s;
+
+ public:
+  explicit Rng(unsigned long long seed = 88172645463325252ULL)
+      : s(seed) {}
+  unsigned Next() {
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return static_cast<unsigned>(s >> 16);
+  }
+};
+
+bool LessDouble(const double& a, const double& b) {
+  return a < b;
+}
+
+struct Options {
+  int reps = 5, warmup = 1;
+  long long max = 1000000;
+  const char* filter = nullptr;
+  bool json = false;
+};
+Options opt;
+bool firstResult = true;
+
+/*
+跑一项
+* body(n, timer) 在timer里计时一次，返回这次做了多少个操作
+*/
+template <class Body>
+void Bench(const char* group, const char* name, int n, Body body) {
+  char full[128];
+  snprintf(full, sizeof(full), "%s/%s", group, name);
+  if (n > opt.max || (opt.filter && !strstr(full, opt.filter)))
+    return;
+  for (int i = 0; i < opt.warmup; ++i) {
+    Timer t;
+    body(n, t);
+  }
+  sjtu::vector<double> samples;
+  long long ops = 0;
+  for (int i = 0; i < opt.reps; ++i) {
+    Timer t;
+    ops = body(n, t);
+    samples.push_back(static_cast<double>(t.Nanos()) / (ops ? ops : 1));
+  }
+  sjtu::Sort(samples, LessDouble);
+  double sum = 0, sq = 0;
+  for (size_t i = 0; i < samples.size(); ++i)
+    sum += samples[i];
+  double mean = sum / samples.size();
+  for (size_t i = 0; i < samples.size(); ++i)
+    sq += (samples[i] - mean) * (samples[i] - mean);
+  double stddev = samples.size() > 1 ? sqrt(sq / (samples.size() - 1)) : 0;
+  double median = samples.size() % 2 ? samples[samples.size() / 2]
+                                     : (samples[samples.size() / 2 - 1] + samples[samples.size() / 2]) / 2;
+  char line[256];
+  if (opt.json) {
+    snprintf(line, sizeof(line),
+             "%s  {\"bench\": \"%s\", \"n\": %d, \"ops\": %lld, \"min\": %.2f, \"median\": %.2f, \"mean\": %.2f, \"stddev\": %.2f, \"max\": %.2f}",
+             firstResult ? "[\n" : ",\n", full, n, ops, samples[0], median, mean, stddev, samples[samples.size() - 1]);
+  } else {
+    if (firstResult) {
+      snprintf(line, sizeof(line), "%-28s %9s %10s %10s %10s %10s %10s  (ns/op)\n", "bench", "n", "min", "median", "mean", "stddev", "max");
+      sjtu::wout << line;
+    }
+    snprintf(line, sizeof(line), "%-28s %9d %10.2f %10.2f %10.2f %10.2f %10.2f\n", full, n, samples[0], median, mean, stddev, samples[samples.size() - 1]);
+  }
+  firstResult = false;
+  sjtu::wout << line;
+  sjtu::wout.flush();
+}
+
+const int Sizes[] = {1000, 10000, 100000, 1000000};
+
+void VectorBenches() {
+  for (int n : Sizes) {
+    Bench("vector", "push_back", n, [](int n, Timer& t) {
+      sjtu::vector<int> v;
+      t.Start();
+      for (int i = 0; i < n; ++i)
+        v.push_back(i);
+      t.Stop();
+      sink = v.size();
+      return n;
+    });
+    Bench("vector", "lookup", n, [](int n, Timer& t) {
+      sjtu::vector<int> v;
+      for (int i = 0; i < n; ++i)
+        v.push_back(i);
+      Rng rng;
+      long long s = 0;
+      t.Start();
+      for (int i = 0; i < n; ++i)
+        s += v[rng.Next() % n];
+      t.Stop();
+      sink = s;
+      return n;
+    });
+    Bench("vector", "scan", n, [](int n, Timer& t) {
+      sjtu::vector<int> v;
+      for (int i = 0; i < n; ++i)
+        v.push_back(i);
+      long long s = 0;
+      t.Start();
+      for (int i = 0; i < n; ++i)
+        s += v[i];
+      t.Stop();
+      sink = s;
+      return n;
+    });
+    Bench("vector", "pop_back", n, [](int n, Timer& t) {
+      sjtu::vector<int> v;
+      for (int i = 0; i < n; ++i)
+        v.push_back(i);
+      t.Start();
+      for (int i = 0; i < n; ++i)
+        v.pop_back();
+      t.Stop();
+      sink = v.size();
+      return n;
+    });
+  }
+}
+
+void MapBenches() {
+  for (int n : Sizes) {
+    if (n > 100000)
+      break;
+    auto fill = [](sjtu::map<int, int>& m, int n) {
+      Rng rng;
+      for (int i = 0; i < n; ++i)
+        m[rng.Next()] = i;
+    };
+    Bench("map", "insert", n, [&](int n, Timer& t) {
+      sjtu::map<int, int> m;
+      Rng rng;
+      t.Start();
+      for (int i = 0; i < n; ++i)
+        m[rng.Next()] = i;
+      t.Stop();
+      sink = m.size();
+      return n;
+    });
+    Bench("map", "lookup", n, [&](int n, Timer& t) {
+      sjtu::map<int, int> m;
+      fill(m, n);
+      Rng rng;  // 同一个种子，查的都是存在的键
+      long long s = 0;
+      t.Start();
+      for (int i = 0; i < n; ++i)
+        s += m.find(rng.Next())->second;
+      t.Stop();
+      sink = s;
+      return n;
+    });
+    Bench("map", "scan", n, [&](int n, Timer& t) {
+      sjtu::map<int, int> m;
+      fill(m, n);
+      long long s = 0;
+      t.Start();
+      for (auto it = m.cbegin(); it != m.cend(); ++it)
+        s += it->second;
+      t.Stop();
+      sink = s;
+      return static_cast<int>(m.size());
+    });
+    Bench("map", "erase", n, [&](int n, Timer& t) {
+      sjtu::map<int, int> m;
+      fill(m, n);
+      int erased = m.size();
+      Rng rng;
+      t.Start();
+      for (int i = 0; i < n; ++i) {
+        auto it = m.find(rng.Next());
+        if (it != m.end())
+          m.erase(it);
+      }
+      t.Stop();
+      sink = m.size();
+      return erased;
+    });
+  }
+}
+
+// B+树落盘，文件建在当前目录（main里已经切到临时目录）
+void BPTreeBenches() {
+  using Tree = sjtu::BPTree<int, int>;
+  auto fresh = []() {
+    std::filesystem::remove("bench_bpt.dat");
+    return new Tree("bench_bpt.dat");
+  };
+  // 键打乱插入，值等于键
+  auto fill = [](Tree* tree, int n, int group) {
+    Rng rng;
+    for (int i = 0; i < n; ++i) {
+      int k = rng.Next() % n;
+      tree->Insert(sjtu::Element<int, int>(k / group, k));
+    }
+  };
+  for (int n : Sizes) {
+    if (n > 100000)
+      break;
+    Bench("bptree", "insert", n, [&](int n, Timer& t) {
+      Tree* tree = fresh();
+      Rng rng;
+      t.Start();
+      for (int i = 0; i < n; ++i) {
+        int k = rng.Next() % n;
+        tree->Insert(sjtu::Element<int, int>(k, k));
+      }
+      t.Stop();
+      delete tree;
+      return n;
+    });
+    Bench("bptree", "lookup", n, [&](int n, Timer& t) {
+      Tree* tree = fresh();
+      fill(tree, n, 1);
+      Rng rng;
+      sjtu::vector<int> res;
+      long long s = 0;
+      t.Start();
+      for (int i = 0; i < n; ++i) {
+        res.clear();
+        tree->Find(rng.Next() % n, res);
+        s += res.size();
+      }
+      t.Stop();
+      sink = s;
+      delete tree;
+      return n;
+    });
+    // 每个键下挂64个值，Find要沿叶子链扫一段
+    Bench("bptree", "scan64", n, [&](int n, Timer& t) {
+      Tree* tree = fresh();
+      fill(tree, n, 64);
+      int keys = (n + 63) / 64;
+      sjtu::vector<int> res;
+      long long s = 0;
+      t.Start();
+      for (int k = 0; k < keys; ++k) {
+        res.clear();
+        tree->Find(k, res);
+        s += res.size();
+      }
+      t.Stop();
+      sink = s;
+      delete tree;
+      return static_cast<int>(s ? s : 1);
+    });
+    Bench("bptree", "remove", n, [&](int n, Timer& t) {
+      Tree* tree = fresh();
+      fill(tree, n, 1);
+      Rng rng;
+      t.Start();
+      for (int i = 0; i < n; ++i) {
+        int k = rng.Next() % n;
+        tree->Remove(sjtu::Element<int, int>(k, k));
+      }
+      t.Stop();
+      delete tree;
+      return n;
+    });
+  }
+  std::filesystem::remove("bench_bpt.dat");
+}
+
+// query_ticket的排序：按compthing、trainID排DirectTravel
+// direct_travel是原来的归并排序，heap是原地堆排序，radix是query_ticket现在用的SortTravel，top20是-k 20
+void FillTravel(sjtu::vector<sjtu::DirectTravel>& v, int n) {
+  Rng rng;
+  char id[24];
+  for (int i = 0; i < n; ++i) {
+    snprintf(id, sizeof(id), "T%u", rng.Next() % 100000);
+    v.push_back(sjtu::DirectTravel(sjtu::ID(id), rng.Next() % 5000, i));
+  }
+}
+void SortBenches() {
+  const int Small[] = {20, 100};
+  for (int n : Small) {
+    Bench("sort", "direct_travel", n, [](int n, Timer& t) {
+      sjtu::vector<sjtu::DirectTravel> v;
+      FillTravel(v, n);
+      t.Start();
+      sjtu::Sort(v, sjtu::comp1);
+      t.Stop();
+      sink = v[0].pos;
+      return n;
+    });
+    Bench("sort", "direct_travel_radix", n, [](int n, Timer& t) {
+      sjtu::vector<sjtu::DirectTravel> v;
+      FillTravel(v, n);
+      t.Start();
+      sjtu::SortTravel(v);
+      t.Stop();
+      sink = v[0].pos;
+      return n;
+    });
+  }
+  for (int n : Sizes) {
+    Bench("sort", "direct_travel", n, [](int n, Timer& t) {
+      sjtu::vector<sjtu::DirectTravel> v;
+      FillTravel(v, n);
+      t.Start();
+      sjtu::Sort(v, sjtu::comp1);
+      t.Stop();
+      sink = v[0].pos;
+      return n;
+    });
+    Bench("sort", "direct_travel_heap", n, [](int n, Timer& t) {
+      sjtu::vector<sjtu::DirectTravel> v;
+      FillTravel(v, n);
+      t.Start();
+      sjtu::TopK(v, n, sjtu::comp1);
+      t.Stop();
+      sink = v[0].pos;
+      return n;
+    });
+    Bench("sort", "direct_travel_radix", n, [](int n, Timer& t) {
+      sjtu::vector<sjtu::DirectTravel> v;
+      FillTravel(v, n);
+      t.Start();
+      sjtu::SortTravel(v);
+      t.Stop();
+      sink = v[0].pos;
+      return n;
+    });
+    Bench("sort", "direct_travel_top20", n, [](int n, Timer& t) {
+      sjtu::vector<sjtu::DirectTravel> v;
+      FillTravel(v, n);
+      t.Start();
+      sjtu::TopK(v, 20, sjtu::comp1);
+      t.Stop();
+      sink = v[0].pos;
+      return n;
+    });
+  }
+}
+
+void CalendarBenches() {
+  const int n = 1000000;
+  Bench("calendar", "date_add", n, [](int n, Timer& t) {
+    Rng rng;
+    long long s = 0;
+    t.Start();
+    for (int i = 0; i < n; ++i) {
+      sjtu::Date d(6, 1 + rng.Next() % 30);
+      d += rng.Next() % 60;
+      s += d.date;
+    }
+    t.Stop();
+    sink = s;
+    return n;
+  });
+  Bench("calendar", "date_diff", n, [](int n, Timer& t) {
+    Rng rng;
+    long long s = 0;
+    t.Start();
+    for (int i = 0; i < n; ++i) {
+      sjtu::Date a(6 + rng.Next() % 3, 1 + rng.Next() % 30), b(6 + rng.Next() % 3, 1 + rng.Next() % 30);
+      s += a - b;
+    }
+    t.Stop();
+    sink = s;
+    return n;
+  });
+  Bench("calendar", "datetime_build", n, [](int n, Timer& t) {
+    Rng rng;
+    long long s = 0;
+    sjtu::Date d(7, 1);
+    t.Start();
+    for (int i = 0; i < n; ++i) {
+      sjtu::Time tm(rng.Next() % 24, rng.Next() % 60);
+      tm += rng.Next() % 5000;  // 跨天
+      sjtu::DateTime dt(d, tm);
+      s += dt.date.date + dt.time.minute;
+    }
+    t.Stop();
+    sink = s;
+    return n;
+  });
+  Bench("calendar", "datetime_diff", n, [](int n, Timer& t) {
+    Rng rng;
+    long long s = 0;
+    t.Start();
+    for (int i = 0; i < n; ++i) {
+      sjtu::DateTime a(6 + rng.Next() % 3, 1 + rng.Next() % 28, rng.Next() % 24, rng.Next() % 60);
+      sjtu::DateTime b(6 + rng.Next() % 3, 1 + rng.Next() % 28, rng.Next() % 24, rng.Next() % 60);
+      s += a - b;
+    }
+    t.Stop();
+    sink = s;
+    return n;
+  });
+  Bench("calendar", "datetime_print", n, [](int n, Timer& t) {
+    sjtu::Writer w(nullptr);
+    sjtu::DateTime dt(7, 15, 13, 45);
+    t.Start();
+    for (int i = 0; i < n; ++i) {
+      w << dt;
+      if (w.size() > (1 << 16))
+        w.clear();
+    }
+    t.Stop();
+    sink = w.size();
+    return n;
+  });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--reps") && i + 1 < argc)
+      opt.reps = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--warmup") && i + 1 < argc)
+      opt.warmup = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--max") && i + 1 < argc)
+      opt.max = atoll(argv[++i]);
+    else if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+      opt.filter = argv[++i];
+    else if (!strcmp(argv[i], "--json"))
+      opt.json = true;
+    else {
+      fprintf(stderr, "usage: %s [--reps N] [--warmup N] [--max N] [--filter S] [--json]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (opt.reps < 1)
+    opt.reps = 1;
+  std::string dir = std::filesystem::temp_directory_path().string() + "/microbench.XXXXXX";
+  if (!mkdtemp(&dir[0])) {
+    perror("mkdtemp");
+    return 2;
+  }
+  std::string cwd = std::filesystem::current_path().string();
+  std::filesystem::current_path(dir);
+
+  VectorBenches();
+  MapBenches();
+  BPTreeBenches();
+  SortBenches();
+  CalendarBenches();
+
+  if (opt.json)
+    sjtu::wout << (firstResult ? "[]\n" : "\n]\n");
+  sjtu::wout.flush();
+  std::filesystem::current_path(cwd);
+  std::filesystem::remove_all(dir);
+  return 0;
+}
@@ -0,0 +1,236 @@
+#ifndef SJTU_MVCC_HPP
+#define SJTU_MVCC_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+
+#include "map.hpp"
+#include "vector.hpp"
+
+namespace sjtu {
+
+/*
+多版本读
+* 每条写指令有一个版本号W，写完后committed=W
+* 快照就是拿快照时的committed，记为S，它看到所有版本号<=S的写
+* 写者覆盖一段数据前把旧内容存进VersionStore，标上validUpTo=W：这份旧内容对S<W的快照可见
+* 读者先读文件里的最新内容，再用validUpTo>S的旧内容盖上去（越旧的越后盖），就得到S时刻的样子
+* 没有快照引用的旧内容在每次写完之后回收
+*/
+
+class VersionStore;
+
+/*
+快照登记处，全局一个
+* 写指令由唯一的执行线程顺序执行，前后调用BeginWrite/EndWrite
+* Acquire在写的途中调用会等这条写做完（执行线程自己只在两条写之间拿快照，不会等）
+* 读者从不阻塞写者
+*/
+class SnapshotRegistry {
+ private:
+  std::mutex m;
+  std::condition_variable idle;
+  long long committed = 1;      // 0留给“不是快照读”
+  long long writing = 0;        // 正在写的版本，0表示没有
+  bool saving = false;          // 这条写要不要存旧内容
+  map<long long, int> active;   // 活着的快照 -> 引用数
+  vector<VersionStore*> stores;
+
+  void Collect();
+
+ public:
+  SnapshotRegistry() = default;
+  SnapshotRegistry(const SnapshotRegistry&) = delete;
+  SnapshotRegistry& operator=(const SnapshotRegistry&) = delete;
+
+  long long Acquire() {
+    std::unique_lock<std::mutex> lk(m);
+    idle.wait(lk, [&] { return writing == 0; });
+    ++active[committed];
+    return committed;
+  }
+  void Release(long long s) {
+    std::lock_guard<std::mutex> lk(m);
+    auto it = active.find(s);
+    if (--it->second == 0)
+      active.erase(it);
+  }
+
+  long long BeginWrite() {
+    std::lock_guard<std::mutex> lk(m);
+    writing = committed + 1;
+    saving = !active.empty();  // 开始写之后不会再有新快照，没人看就不用存
+    return writing;
+  }
+  void EndWrite() {
+    {
+      std::lock_guard<std::mutex> lk(m);
+      committed = writing;
+      writing = 0;
+      saving = false;
+    }
+    idle.notify_all();
+    Collect();
+  }
+  // 当前写要存旧内容时返回它的版本号，否则返回0；只在写线程上调用
+  long long SaveVersion() const {
+    return saving ? writing : 0;
+  }
+  // 最老的活快照，没有就是committed
+  long long Oldest() {
+    std::lock_guard<std::mutex> lk(m);
+    return active.empty() ? committed : active.cbegin()->first;
+  }
+
+  void Register(VersionStore* store) {
+    std::lock_guard<std::mutex> lk(m);
+    stores.push_back(store);
+  }
+  void Unregister(VersionStore* store) {
+    std::lock_guard<std::mutex> lk(m);
+    for (size_t i = 0; i < stores.size(); ++i)
+      if (stores[i] == store) {
+        stores[i] = stores[stores.size() - 1];
+        stores.pop_back();
+        return;
+      }
+  }
+};
+
+SnapshotRegistry snapshots;
+
+// 当前线程正在用的快照，0表示读最新状态
+thread_local long long readSnapshot = 0;
+
+// 在一段作用域里以快照身份读，结束时归还快照
+class SnapshotScope {
+ private:
+  long long prev;
+
+ public:
+  explicit SnapshotScope(long long s)
+      : prev(readSnapshot) {
+    readSnapshot = s;
+  }
+  SnapshotScope(const SnapshotScope&) = delete;
+  SnapshotScope& operator=(const SnapshotScope&) = delete;
+  ~SnapshotScope() {
+    snapshots.Release(readSnapshot);
+    readSnapshot = prev;
+  }
+};
+
+/*
+一个文件的旧内容仓库
+* key是记录/块的编号，每个key一条链，新的在前
+* 一份旧内容是这条记录 [off, off+len) 这段字节在版本validUpTo写入之前的样子
+*/
+class VersionStore {
+ private:
+  struct Version {
+    long long validUpTo;
+    size_t off, len;
+    char* data;
+    Version* older;
+  };
+  mutable std::shared_mutex m;
+  map<long long, Version*> chains;
+  std::atomic<size_t> count{0};  // 旧内容份数，为0时读者不用加锁
+
+  static void Free(Version* v) {
+    while (v) {
+      Version* o = v->older;
+      free(v->data);
+      delete v;
+      v = o;
+    }
+  }
+
+ public:
+  VersionStore() {
+    snapshots.Register(this);
+  }
+  VersionStore(const VersionStore&) = delete;
+  VersionStore& operator=(const VersionStore&) = delete;
+  ~VersionStore() {
+    snapshots.Unregister(this);
+    for (auto it = chains.begin(); it != chains.end(); ++it)
+      Free(it->second);
+  }
+
+  // 版本v写 [off, off+len) 之前是否已经存过
+  bool Saved(long long key, long long v, size_t off, size_t len) const {
+    std::shared_lock<std::shared_mutex> lk(m);
+    auto it = chains.find(key);
+    if (it == chains.cend())
+      return false;
+    for (Version* p = it->second; p && p->validUpTo == v; p = p->older)
+      if (p->off == off && p->len >= len)
+        return true;
+    return false;
+  }
+  // 存一份旧内容，data必须是malloc出来的，所有权交给仓库
+  void Save(long long key, long long v, size_t off, size_t len, char* data) {
+    std::unique_lock<std::shared_mutex> lk(m);
+    Version*& head = chains[key];
+    head = new Version{v, off, len, data, head};
+    ++count;
+  }
+
+  /*
+  把快照s下的旧内容盖到rec上
+  * rec是这条记录从第0个字节开始的前n个字节，刚从文件里读出来
+  * 从新往旧盖，同一段最后留下的是s之后第一次写之前的内容
+  */
+  void Overlay(long long key, long long s, void* rec, size_t n) const {
+    if (!count)
+      return;
+    std::shared_lock<std::shared_mutex> lk(m);
+    auto it = chains.find(key);
+    if (it == chains.cend())
+      return;
+    char* dst = static_cast<char*>(rec);
+    for (Version* p = it->second; p && p->validUpTo > s; p = p->older) {
+      if (p->off >= n)
+        continue;
+      size_t len = p->off + p->len > n ? n - p->off : p->len;
+      memcpy(dst + p->off, p->data, len);
+    }
+  }
+
+  // 丢掉validUpTo<=oldest的旧内容，已经没有快照会看它们
+  void Collect(long long oldest) {
+    std::unique_lock<std::shared_mutex> lk(m);
+    if (!count)
+      return;
+    vector<long long> empty;
+    for (auto it = chains.begin(); it != chains.end(); ++it) {
+      Version** link = &it->second;
+      while (*link && (*link)->validUpTo > oldest)
+        link = &(*link)->older;
+      for (Version* p = *link; p; p = p->older)
+        --count;
+      Free(*link);
+      *link = nullptr;
+      if (!it->second)
+        empty.push_back(it->first);
+    }
+    for (size_t i = 0; i < empty.size(); ++i)
+      chains.erase(chains.find(empty[i]));
+  }
+};
+
+void SnapshotRegistry::Collect() {
+  long long oldest = Oldest();
+  std::lock_guard<std::mutex> lk(m);
+  for (size_t i = 0; i < stores.size(); ++i)
+    stores[i]->Collect(oldest);
+}
+
+}  // namespace sjtu
+
+#endif  // !SJTU_MVCC_HPP
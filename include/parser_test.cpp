@@ -0,0 +1,101 @@
+#include "Parser.hpp"
+
+// ParseCommand的表驱动用例，不碰数据文件也不经过Executor
+// parser_test：全部通过返回0，否则在stderr列出失败的行，返回失败条数
+// * 每种指令一条；重复的参数以最后一个为准；不认识的参数名忽略；参数名不是 -x 的整行当作不认识的指令
+
+namespace {
+
+using sjtu::Command;
+
+struct Case {
+  const char* line;
+  sjtu::CommandType type;
+  bool (*check)(const Command&);  // 为空时只看type
+};
+
+const Case Cases[] = {
+    {"[1] add_user -c cur -u bob -p pw -n Bob -m b@x -g 7", sjtu::CMD_ADD_USER,
+     [](const Command& c) {
+       const sjtu::AddUserArgs& a = c.addUser;
+       return a.cur == "cur" && a.user == "bob" && a.password == "pw" && a.name == "Bob" && a.mail == "b@x" && a.privilege == 7;
+     }},
+    {"[2] login -u bob -p pw", sjtu::CMD_LOGIN,
+     [](const Command& c) { return c.login.user == "bob" && c.login.password == "pw"; }},
+    {"[3] logout -u bob", sjtu::CMD_LOGOUT,
+     [](const Command& c) { return c.user.user == "bob"; }},
+    {"[4] query_profile -c cur -u bob", sjtu::CMD_QUERY_PROFILE,
+     [](const Command& c) { return c.queryProfile.cur == "cur" && c.queryProfile.user == "bob"; }},
+    {"[5] modify_profile -c cur -u bob -m new@x", sjtu::CMD_MODIFY_PROFILE,
+     [](const Command& c) {
+       const sjtu::ModifyProfileArgs& a = c.modifyProfile;
+       return a.user == "bob" && a.mail == "new@x" && a.password.empty() && a.privilege == -1;
+     }},
+    {"[6] add_train -i T1 -n 3 -m 100 -s A|B|C -p 10|20 -x 08:00 -t 30|40 -o 5 -d 06-01|08-31 -y G", sjtu::CMD_ADD_TRAIN,
+     [](const Command& c) {
+       const sjtu::AddTrainArgs& a = c.addTrain;
+       return a.trainID == "T1" && a.stationNum == 3 && a.seatNum == 100 && a.stations == "A|B|C" && a.prices == "10|20" &&
+              a.startTime == "08:00" && a.travelTimes == "30|40" && a.stopoverTimes == "5" && a.saleDate == "06-01|08-31" && a.type == 'G';
+     }},
+    {"[7] delete_train -i T1", sjtu::CMD_DELETE_TRAIN,
+     [](const Command& c) { return c.train.trainID == "T1"; }},
+    {"[8] release_train -i T1", sjtu::CMD_RELEASE_TRAIN,
+     [](const Command& c) { return c.train.trainID == "T1"; }},
+    {"[9] query_train -i T1 -d 07-02", sjtu::CMD_QUERY_TRAIN,
+     [](const Command& c) { return c.queryTrain.trainID == "T1" && c.queryTrain.date == sjtu::Date(7, 2); }},
+    {"[10] query_ticket -s A -t C -d 06-15 -p cost", sjtu::CMD_QUERY_TICKET,
+     [](const Command& c) {
+       const sjtu::QueryTicketArgs& a = c.queryTicket;
+       return a.from == "A" && a.to == "C" && a.date == sjtu::Date(6, 15) && a.type == sjtu::COST && a.limit == -1;
+     }},
+    {"[11] query_transfer -s A -t C -d 06-15", sjtu::CMD_QUERY_TRANSFER,
+     [](const Command& c) { return c.queryTicket.from == "A" && c.queryTicket.type == sjtu::TIME; }},
+    {"[12] buy_ticket -u bob -i T1 -d 06-15 -n 2 -f A -t C -q true", sjtu::CMD_BUY_TICKET,
+     [](const Command& c) {
+       const sjtu::BuyTicketArgs& a = c.buyTicket;
+       return a.user == "bob" && a.trainID == "T1" && a.date == sjtu::Date(6, 15) && a.num == 2 && a.from == "A" && a.to == "C" && a.queue;
+     }},
+    {"[13] query_order -u bob -s pending -l 5", sjtu::CMD_QUERY_ORDER,
+     [](const Command& c) { return c.queryOrder.user == "bob" && c.queryOrder.status == sjtu::QUEUE && c.queryOrder.limit == 5; }},
+    {"[14] query_order -u bob -s bogus", sjtu::CMD_QUERY_ORDER,
+     [](const Command& c) { return c.queryOrder.status == sjtu::BadStatus; }},
+    {"[15] refund_ticket -u bob", sjtu::CMD_REFUND_TICKET,
+     [](const Command& c) { return c.refundTicket.user == "bob" && c.refundTicket.num == 1; }},
+    {"[16] clear", sjtu::CMD_CLEAR, nullptr},
+    {"[17] exit", sjtu::CMD_EXIT, nullptr},
+    {"[18] stats -r true", sjtu::CMD_STATS,
+     [](const Command& c) { return c.stats.reset; }},
+    {"[19] io_stats", sjtu::CMD_IO_STATS,
+     [](const Command& c) { return !c.stats.reset; }},
+    {"[20] trace_dump", sjtu::CMD_TRACE_DUMP, nullptr},
+    {"[21] no_such_command -u bob", sjtu::CMD_UNKNOWN, nullptr},
+    // 重复的参数以最后一个为准
+    {"[22] login -u alice -p pw -u bob", sjtu::CMD_LOGIN,
+     [](const Command& c) { return c.login.user == "bob" && c.login.password == "pw"; }},
+    // 不认识的参数名忽略，其他参数照常
+    {"[23] login -u bob -z 1 -p pw", sjtu::CMD_LOGIN,
+     [](const Command& c) { return c.login.user == "bob" && c.login.password == "pw"; }},
+    // 参数名太短、太长、不以'-'开头，或者最后一个参数名没有值
+    {"[24] login - bob -p pw", sjtu::CMD_UNKNOWN, nullptr},
+    {"[25] login u bob", sjtu::CMD_UNKNOWN, nullptr},
+    {"[26] login -uu bob", sjtu::CMD_UNKNOWN, nullptr},
+    {"[27] login -u bob -p", sjtu::CMD_UNKNOWN, nullptr},
+};
+
+}  // namespace
+
+int main() {
+  int failed = 0;
+  Command cmd;
+  if (sjtu::ParseCommand("   ", cmd)) {
+    fprintf(stderr, "blank line should not parse\n");
+    ++failed;
+  }
+  for (const Case& t : Cases) {
+    if (!sjtu::ParseCommand(t.line, cmd) || cmd.type != t.type || (t.check && !t.check(cmd))) {
+      fprintf(stderr, "failed: %s\n", t.line);
+      ++failed;
+    }
+  }
+  return failed;
+}
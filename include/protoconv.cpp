@@ -0,0 +1,68 @@
+#include "Parser.hpp"
+#include "Protocol.hpp"
+
+// 文本协议和二进制协议互转，测试用
+// protoconv encode：标准输入的文本指令 -> 二进制请求帧
+// protoconv decode：标准输入的二进制帧 -> 文本，请求帧变成指令行，回复帧变成输出
+// 例：protoconv encode < 1.in | 发给服务器 | protoconv decode 应该和文本跑出来的1.out一样
+
+namespace {
+
+int Encode() {
+  sjtu::LineReader reader(0);
+  sjtu::Command cmd;
+  string_view line;
+  while (reader.NextLine(line)) {
+    if (!sjtu::ParseCommand(line, cmd))
+      continue;
+    if (cmd.type == sjtu::CMD_UNKNOWN) {
+      fprintf(stderr, "unknown or malformed command: %.*s\n", static_cast<int>(cmd.name.size()), cmd.name.data());
+      return 1;
+    }
+    sjtu::EncodeRequest(cmd, sjtu::wout);
+  }
+  return 0;
+}
+
+int Decode() {
+  // 整个读进来再切帧
+  sjtu::Writer in(nullptr);
+  while (true) {
+    char* p = in.reserve(1 << 16);
+    ssize_t n = read(0, p, 1 << 16);
+    if (n <= 0)
+      break;
+    in.commit(n);
+  }
+  size_t beg = 0;
+  sjtu::Command cmd;
+  while (beg < in.size()) {
+    const char* p = in.data() + beg;
+    size_t left = in.size() - beg;
+    long n;
+    if (static_cast<unsigned char>(p[0]) == sjtu::RequestMagic) {
+      n = sjtu::DecodeRequest(p, left, cmd);
+      if (n > 0)
+        sjtu::FormatRequest(cmd, sjtu::wout);
+    } else {
+      n = sjtu::DecodeReply(p, left, sjtu::wout);
+    }
+    if (n <= 0) {
+      fprintf(stderr, "bad frame at byte %zu\n", beg);
+      return 1;
+    }
+    beg += n;
+  }
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc == 2 && !strcmp(argv[1], "encode"))
+    return Encode();
+  if (argc == 2 && !strcmp(argv[1], "decode"))
+    return Decode();
+  fprintf(stderr, "usage: %s encode|decode < input > output\n", argv[0]);
+  return 2;
+}
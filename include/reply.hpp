@@ -0,0 +1,186 @@
+#ifndef SJTU_REPLY_HPP
+#define SJTU_REPLY_HPP
+
+#include "stats.hpp"
+#include "wire.hpp"
+
+namespace sjtu {
+
+/*
+指令的回复
+* 各个系统不直接往wout里写，而是调这里的函数，一次一行
+* 文本协议下和原来的输出逐字节一致
+* 二进制协议下每行写成一条结构化的记录：1字节行类型 + 字段，帧头由Executor写
+*/
+enum ReplyRow : unsigned char {
+  ROW_INT = 1,  // i32
+  ROW_TEXT,     // str
+  ROW_PROFILE,  // userID name mail，privilege i32
+  ROW_TRAIN,    // trainID，type u8
+  ROW_STOP,     // station，到站/离站日期时间，price i32，seat i32（-1表示x）
+  ROW_TICKET,   // trainID from 出发 to 到达，price i32，seat i32
+  ROW_ORDER,    // status u8，其余同ROW_TICKET，最后是票数
+  ROW_STAT,     // 指令名，count p50 p90 p99 max 各u64，延迟单位纳秒
+  ROW_IO,       // 文件名 指令名，reads writes read_bytes write_bytes seeks 各u64
+};
+
+// 当前线程正在执行的指令是不是二进制请求，由Executor设置
+thread_local bool binaryReply = false;
+
+const char* const OrderStatusText[3] = {"[success] ", "[pending] ", "[refunded] "};
+
+// 以下Text*是文本格式，二进制回复转文本时也用它们
+inline void TextDateTime(Writer& w, const DateTime* dt) {
+  if (dt)
+    w << *dt;
+  else
+    w << "xx-xx xx:xx";
+}
+inline void TextProfile(Writer& w, string_view id, string_view name, string_view mail, int privilege) {
+  w << id << ' ' << name << ' ' << mail << ' ' << privilege << '\n';
+}
+inline void TextTrain(Writer& w, string_view id, char type) {
+  w << id << ' ' << type << '\n';
+}
+inline void TextStop(Writer& w, string_view station, const DateTime* arrive, const DateTime* leave, int price, int seat) {
+  w << station << ' ';
+  TextDateTime(w, arrive);
+  w << " -> ";
+  TextDateTime(w, leave);
+  w << ' ' << price << ' ';
+  if (seat < 0)
+    w << 'x';
+  else
+    w << seat;
+  w << '\n';
+}
+inline void TextTicket(Writer& w, string_view trainID, string_view from, const DateTime& depart, string_view to, const DateTime& arrive, int price, int seat) {
+  w << trainID << ' ' << from << ' ' << depart << " -> " << to << ' ' << arrive << ' ' << price << ' ' << seat << '\n';
+}
+inline void TextStat(Writer& w, string_view name, uint64_t count, uint64_t p50, uint64_t p90, uint64_t p99, uint64_t max) {
+  w << name << ' ' << static_cast<long long>(count) << ' ' << static_cast<long long>(p50) << ' ' << static_cast<long long>(p90)
+    << ' ' << static_cast<long long>(p99) << ' ' << static_cast<long long>(max) << '\n';
+}
+// 一行一个JSON对象，方便脚本直接读
+inline void TextIo(Writer& w, string_view file, string_view command, uint64_t reads, uint64_t writes, uint64_t readBytes, uint64_t writeBytes, uint64_t seeks) {
+  w << "{\"file\":\"" << file << "\",\"command\":\"" << command << "\",\"reads\":" << static_cast<long long>(reads)
+    << ",\"writes\":" << static_cast<long long>(writes) << ",\"read_bytes\":" << static_cast<long long>(readBytes)
+    << ",\"write_bytes\":" << static_cast<long long>(writeBytes) << ",\"seeks\":" << static_cast<long long>(seeks) << "}\n";
+}
+
+inline void ReplyInt(long long v) {
+  PhaseScope phase(PHASE_OUTPUT);
+  if (!binaryReply) {
+    wout << v << '\n';
+    return;
+  }
+  Put8(wout, ROW_INT);
+  Put32(wout, static_cast<uint32_t>(v));
+}
+inline void ReplyText(string_view s) {
+  PhaseScope phase(PHASE_OUTPUT);
+  if (!binaryReply) {
+    wout << s << '\n';
+    return;
+  }
+  Put8(wout, ROW_TEXT);
+  PutStr(wout, s);
+}
+inline void ReplyProfile(string_view id, string_view name, string_view mail, int privilege) {
+  PhaseScope phase(PHASE_OUTPUT);
+  if (!binaryReply) {
+    TextProfile(wout, id, name, mail, privilege);
+    return;
+  }
+  Put8(wout, ROW_PROFILE);
+  PutStr(wout, id);
+  PutStr(wout, name);
+  PutStr(wout, mail);
+  Put32(wout, privilege);
+}
+inline void ReplyTrain(string_view id, char type) {
+  PhaseScope phase(PHASE_OUTPUT);
+  if (!binaryReply) {
+    TextTrain(wout, id, type);
+    return;
+  }
+  Put8(wout, ROW_TRAIN);
+  PutStr(wout, id);
+  Put8(wout, type);
+}
+// 始发站没有到站时间、终点站没有离站时间，传nullptr；终点站的座位传-1
+inline void ReplyStop(string_view station, const DateTime* arrive, const DateTime* leave, int price, int seat) {
+  PhaseScope phase(PHASE_OUTPUT);
+  if (!binaryReply) {
+    TextStop(wout, station, arrive, leave, price, seat);
+    return;
+  }
+  Put8(wout, ROW_STOP);
+  PutStr(wout, station);
+  Put32(wout, arrive ? PackDateTime(*arrive) : NoDateTime);
+  Put32(wout, leave ? PackDateTime(*leave) : NoDateTime);
+  Put32(wout, price);
+  Put32(wout, seat);
+}
+inline void PutTicket(string_view trainID, string_view from, const DateTime& depart, string_view to, const DateTime& arrive, int price, int seat) {
+  PutStr(wout, trainID);
+  PutStr(wout, from);
+  Put32(wout, PackDateTime(depart));
+  PutStr(wout, to);
+  Put32(wout, PackDateTime(arrive));
+  Put32(wout, price);
+  Put32(wout, seat);
+}
+inline void ReplyTicket(string_view trainID, string_view from, const DateTime& depart, string_view to, const DateTime& arrive, int price, int seat) {
+  PhaseScope phase(PHASE_OUTPUT);
+  if (!binaryReply) {
+    TextTicket(wout, trainID, from, depart, to, arrive, price, seat);
+    return;
+  }
+  Put8(wout, ROW_TICKET);
+  PutTicket(trainID, from, depart, to, arrive, price, seat);
+}
+inline void ReplyOrder(int status, string_view trainID, string_view from, const DateTime& depart, string_view to, const DateTime& arrive, int price, int num) {
+  PhaseScope phase(PHASE_OUTPUT);
+  if (!binaryReply) {
+    wout << OrderStatusText[status];
+    TextTicket(wout, trainID, from, depart, to, arrive, price, num);
+    return;
+  }
+  Put8(wout, ROW_ORDER);
+  Put8(wout, status);
+  PutTicket(trainID, from, depart, to, arrive, price, num);
+}
+inline void ReplyStat(string_view name, uint64_t count, uint64_t p50, uint64_t p90, uint64_t p99, uint64_t max) {
+  PhaseScope phase(PHASE_OUTPUT);
+  if (!binaryReply) {
+    TextStat(wout, name, count, p50, p90, p99, max);
+    return;
+  }
+  Put8(wout, ROW_STAT);
+  PutStr(wout, name);
+  Put64(wout, count);
+  Put64(wout, p50);
+  Put64(wout, p90);
+  Put64(wout, p99);
+  Put64(wout, max);
+}
+inline void ReplyIo(string_view file, string_view command, uint64_t reads, uint64_t writes, uint64_t readBytes, uint64_t writeBytes, uint64_t seeks) {
+  PhaseScope phase(PHASE_OUTPUT);
+  if (!binaryReply) {
+    TextIo(wout, file, command, reads, writes, readBytes, writeBytes, seeks);
+    return;
+  }
+  Put8(wout, ROW_IO);
+  PutStr(wout, file);
+  PutStr(wout, command);
+  Put64(wout, reads);
+  Put64(wout, writes);
+  Put64(wout, readBytes);
+  Put64(wout, writeBytes);
+  Put64(wout, seeks);
+}
+
+}  // namespace sjtu
+
+#endif  // !SJTU_REPLY_HPP
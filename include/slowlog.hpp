@@ -0,0 +1,105 @@
+#ifndef SJTU_SLOWLOG_HPP
+#define SJTU_SLOWLOG_HPP
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "writer.hpp"
+
+namespace sjtu {
+
+/*
+慢指令日志
+* 执行时间超过阈值的指令，由Executor把一行记录交给Append
+* Append只在锁里把字节拷进待写缓冲区，不碰文件；后台线程把缓冲区换出来再写文件
+* 待写的字节超过上限（磁盘跟不上）时丢掉新记录并计数，执行线程永远不会等I/O
+* 析构时把剩下的都写完
+*/
+class SlowLog {
+ private:
+  static const size_t MaxPending = 1 << 22;
+
+  int fd = -1;
+  uint64_t threshold;  // 纳秒
+  std::mutex m;
+  std::condition_variable cv;
+  Writer pending{nullptr};  // 执行线程往这里追加
+  Writer draining{nullptr};  // 后台线程正在写的
+  bool stopping = false;
+  std::atomic<uint64_t> dropped{0};
+  std::thread worker;
+
+  void Drain() {
+    std::unique_lock<std::mutex> lk(m);
+    while (true) {
+      cv.wait(lk, [this] { return stopping || pending.size(); });
+      if (!pending.size() && stopping)
+        return;
+      pending.swap(draining);
+      lk.unlock();
+      const char* p = draining.data();
+      size_t n = draining.size();
+      while (n) {
+        ssize_t w = write(fd, p, n);
+        if (w <= 0)
+          break;  // 写不进去就放弃这一批，不影响执行
+        p += w, n -= w;
+      }
+      draining.clear();
+      lk.lock();
+    }
+  }
+
+ public:
+  SlowLog(const char* path, uint64_t thresholdNanos)
+      : threshold(thresholdNanos) {
+    fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd >= 0)
+      worker = std::thread(&SlowLog::Drain, this);
+  }
+  SlowLog(const SlowLog&) = delete;
+  SlowLog& operator=(const SlowLog&) = delete;
+  ~SlowLog() {
+    if (fd < 0)
+      return;
+    {
+      std::lock_guard<std::mutex> lk(m);
+      stopping = true;
+    }
+    cv.notify_one();
+    worker.join();
+    close(fd);
+  }
+
+  bool IsOpen() const {
+    return fd >= 0;
+  }
+  uint64_t Threshold() const {
+    return threshold;
+  }
+  uint64_t Dropped() const {
+    return dropped.load(std::memory_order_relaxed);
+  }
+  // 追加一条完整的记录（带换行）
+  void Append(const char* p, size_t n) {
+    {
+      std::lock_guard<std::mutex> lk(m);
+      if (pending.size() + n > MaxPending) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      pending.write(p, n);
+    }
+    cv.notify_one();
+  }
+};
+
+}  // namespace sjtu
+
+#endif  // !SJTU_SLOWLOG_HPP
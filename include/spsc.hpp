@@ -0,0 +1,69 @@
+#ifndef SJTU_SPSC_HPP
+#define SJTU_SPSC_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+
+namespace sjtu {
+
+/*
+有界无锁单生产者单消费者队列
+* 容量N必须是2的幂，实际最多放N个
+* head只由消费者写，tail只由生产者写，各占一条cache line
+* Push/Pop是阻塞版本：先自旋，再让出时间片，最后短暂睡眠
+*/
+template <class T, size_t N>
+class SpscQueue {
+  static_assert((N & (N - 1)) == 0, "capacity must be a power of 2");
+
+ private:
+  alignas(64) std::atomic<size_t> head{0};  // 下一个要读的位置
+  alignas(64) std::atomic<size_t> tail{0};  // 下一个要写的位置
+  alignas(64) T data[N];
+
+  static void Backoff(int& round) {
+    if (round < 64)
+      ;  // 自旋
+    else if (round < 128)
+      std::this_thread::yield();
+    else
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    ++round;
+  }
+
+ public:
+  bool TryPush(const T& x) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == N)
+      return false;  // 满
+    data[t & (N - 1)] = x;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+  bool TryPop(T& x) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+      return false;  // 空
+    x = data[h & (N - 1)];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+  void Push(const T& x) {
+    int round = 0;
+    while (!TryPush(x))
+      Backoff(round);
+  }
+  T Pop() {
+    T x;
+    int round = 0;
+    while (!TryPop(x))
+      Backoff(round);
+    return x;
+  }
+};
+
+}  // namespace sjtu
+
+#endif  // !SJTU_SPSC_HPP
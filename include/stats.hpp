@@ -0,0 +1,175 @@
+#ifndef SJTU_STATS_HPP
+#define SJTU_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "trace.hpp"
+
+namespace sjtu {
+
+/*
+延迟直方图，HDR式的对数分桶
+* 小于8的值一个值一个桶；之后每个2的幂区间再均分成8个子桶，相对误差不超过1/8
+* 64位的值最多用到496个桶，不用预先知道范围
+* 计数是relaxed原子变量，多个线程同时记录不用加锁；读的时候不保证是同一瞬间的快照
+*/
+class LatencyHistogram {
+ private:
+  static const int SubBits = 3;
+  static const int Sub = 1 << SubBits;
+  static const int Buckets = (64 - SubBits + 1) * Sub;
+
+  std::atomic<uint64_t> counts[Buckets];
+  std::atomic<uint64_t> maxValue{0};
+
+  static int Bucket(uint64_t v) {
+    if (v < Sub)
+      return static_cast<int>(v);
+    int e = 63 - __builtin_clzll(v);  // 最高位，>=SubBits
+    return (e - SubBits + 1) * Sub + static_cast<int>((v >> (e - SubBits)) & (Sub - 1));
+  }
+  // 桶里最大的值，报告分位数时用上界，宁大勿小
+  static uint64_t BucketHigh(int b) {
+    if (b < Sub)
+      return b;
+    int e = b / Sub + SubBits - 1;
+    uint64_t m = Sub + b % Sub;
+    return ((m + 1) << (e - SubBits)) - 1;
+  }
+
+ public:
+  LatencyHistogram() {
+    Reset();
+  }
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  void Record(uint64_t v) {
+    counts[Bucket(v)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t m = maxValue.load(std::memory_order_relaxed);
+    while (v > m && !maxValue.compare_exchange_weak(m, v, std::memory_order_relaxed))
+      ;
+  }
+  void Reset() {
+    for (int i = 0; i < Buckets; ++i)
+      counts[i].store(0, std::memory_order_relaxed);
+    maxValue.store(0, std::memory_order_relaxed);
+  }
+
+  uint64_t Count() const {
+    uint64_t n = 0;
+    for (int i = 0; i < Buckets; ++i)
+      n += counts[i].load(std::memory_order_relaxed);
+    return n;
+  }
+  uint64_t Max() const {
+    return maxValue.load(std::memory_order_relaxed);
+  }
+  // 第p分位（0~1），落在哪个桶就报那个桶的上界，但不超过最大值
+  uint64_t Percentile(double p) const {
+    uint64_t total = Count();
+    if (!total)
+      return 0;
+    uint64_t rank = static_cast<uint64_t>(p * total);
+    if (rank >= total)
+      rank = total - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < Buckets; ++i) {
+      seen += counts[i].load(std::memory_order_relaxed);
+      if (seen > rank) {
+        uint64_t high = BucketHigh(i), m = Max();
+        return high < m ? high : m;
+      }
+    }
+    return Max();
+  }
+};
+
+// 单调时钟，纳秒
+inline uint64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+一条指令内部的分阶段计时，慢指令日志用
+* 阶段可以嵌套，时间只记在最内层的阶段上，各阶段加起来就是总时间
+* 没开（没有慢日志）的时候PhaseScope只判断一次on
+* 编译时定义了TICKET_TRACE的话，每个PhaseScope同时是一个trace区间，名字默认是阶段名
+*/
+enum Phase {
+  PHASE_OTHER = 0,  // 不属于下面任何一段，比如换乘的组合枚举
+  PHASE_INDEX,      // B+树的Find/Insert/Remove
+  PHASE_RECORD,     // 车次、用户、订单记录的读写
+  PHASE_SEAT,       // 余票检查和座位增减
+  PHASE_SORT,
+  PHASE_OUTPUT,     // 格式化回复
+  PHASE_COUNT
+};
+const char* const PhaseNames[PHASE_COUNT] = {"other", "index", "record", "seat", "sort", "output"};
+
+struct PhaseClock {
+  bool on = false;
+  int cur = PHASE_OTHER;
+  uint64_t since = 0;
+  uint64_t total[PHASE_COUNT] = {};
+
+  void Start() {
+    on = true;
+    cur = PHASE_OTHER;
+    for (int i = 0; i < PHASE_COUNT; ++i)
+      total[i] = 0;
+    since = NowNanos();
+  }
+  void Stop() {
+    total[cur] += NowNanos() - since;
+    on = false;
+  }
+  // 切到阶段p，返回之前所在的阶段；没开返回-1
+  int Enter(int p) {
+    if (!on)
+      return -1;
+    uint64_t now = NowNanos();
+    total[cur] += now - since;
+    since = now;
+    int outer = cur;
+    cur = p;
+    return outer;
+  }
+  void Leave(int outer) {
+    if (outer < 0 || !on)
+      return;
+    uint64_t now = NowNanos();
+    total[cur] += now - since;
+    since = now;
+    cur = outer;
+  }
+};
+thread_local PhaseClock phaseClock;
+
+class PhaseScope {
+ private:
+  int outer;
+#ifdef TICKET_TRACE
+  TraceSpan span;
+#endif
+
+ public:
+  explicit PhaseScope(Phase p, [[maybe_unused]] const char* name = nullptr)
+      : outer(phaseClock.Enter(p))
+#ifdef TICKET_TRACE
+      , span(name ? name : PhaseNames[p])
+#endif
+  {
+  }
+  PhaseScope(const PhaseScope&) = delete;
+  PhaseScope& operator=(const PhaseScope&) = delete;
+  ~PhaseScope() {
+    phaseClock.Leave(outer);
+  }
+};
+
+}  // namespace sjtu
+
+#endif  // !SJTU_STATS_HPP
@@ -0,0 +1,86 @@
+#ifndef SJTU_STATUSTABLE_HPP
+#define SJTU_STATUSTABLE_HPP
+
+#include <string>
+
+#include "file.hpp"
+#include "vector.hpp"
+
+namespace sjtu {
+
+/*
+订单状态表，每个订单2比特，一个字节放4个
+* 整张表常驻内存，查状态、改状态都不碰文件
+* 改过的字节记成一个脏区间，Flush时一次写出去；文件里就是这张表本身，没有头
+* 订单总数由调用者保存，打开时按它读回来
+* 只读的Get可以并发；Append/Set/Flush要和它们互斥（由调度保证）
+*/
+class StatusTable {
+ private:
+  File file;
+  vector<unsigned char> bits;
+  size_t dirtyLo = 0, dirtyHi = 0;  // 脏字节区间 [lo, hi)
+
+  void Touch(size_t byte) {
+    if (dirtyLo == dirtyHi) {
+      dirtyLo = byte, dirtyHi = byte + 1;
+      return;
+    }
+    if (byte < dirtyLo)
+      dirtyLo = byte;
+    if (byte >= dirtyHi)
+      dirtyHi = byte + 1;
+  }
+
+ public:
+  StatusTable() = default;
+  StatusTable(const StatusTable&) = delete;
+  StatusTable& operator=(const StatusTable&) = delete;
+  ~StatusTable() {
+    Flush();
+  }
+
+  // 打开文件，读回前count个订单的状态
+  void Open(const std::string& name, int count) {
+    file.Open(name);
+    size_t n = (count + 3) / 4;
+    bits.clear();
+    for (size_t i = 0; i < n; ++i)
+      bits.push_back(0);
+    if (n)
+      file.Read(0, &bits[0], n);
+  }
+
+  int Get(int id) const {
+    return bits[id >> 2] >> ((id & 3) * 2) & 3;
+  }
+  void Set(int id, int status) {
+    unsigned char& b = bits[id >> 2];
+    int shift = (id & 3) * 2;
+    b = (b & ~(3 << shift)) | status << shift;
+    Touch(id >> 2);
+  }
+  // 新订单id（必须是当前总数）的状态
+  void Append(int id, int status) {
+    if ((id >> 2) >= (int)bits.size())
+      bits.push_back(0);
+    Set(id, status);
+  }
+
+  // 把脏区间写回文件
+  void Flush() {
+    if (dirtyLo == dirtyHi)
+      return;
+    file.Write(dirtyLo, &bits[dirtyLo], dirtyHi - dirtyLo);
+    dirtyLo = dirtyHi = 0;
+  }
+  void Clear() {
+    bits.clear();
+    dirtyLo = dirtyHi = 0;
+    file.Truncate(0);
+  }
+};
+
+}  // namespace sjtu
+
+#endif  // !SJTU_STATUSTABLE_HPP
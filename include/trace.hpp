@@ -0,0 +1,178 @@
+#ifndef SJTU_TRACE_HPP
+#define SJTU_TRACE_HPP
+
+#include <cstdint>
+#include <cstdio>
+
+/*
+Chrome trace格式的区间记录（chrome://tracing、Perfetto能直接打开）
+* 只有定义了TICKET_TRACE才编进去，没定义时TRACE_SPAN是空语句，ExportTrace直接返回-1
+* 每个线程一个环形缓冲区，第一次记录时分配，满了覆盖最旧的；线程退出后缓冲区还留着，导出时还能看到
+* 每条记录是一个完整区间（ph:"X"）：名字、开始、结束，可以带一个整数参数（指令的时间戳）
+* 名字必须是静态字符串，只存指针
+* 导出时别的线程可能还在写，正在被覆盖的那几条可能前后不一致，但不会读到无效的名字
+*/
+#ifdef TICKET_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "vector.hpp"
+#include "writer.hpp"
+
+#ifndef TICKET_TRACE_EVENTS
+#define TICKET_TRACE_EVENTS (1 << 18)  // 每个线程保留的记录数，2的幂
+#endif
+
+namespace sjtu {
+
+class TraceRing {
+  static_assert((TICKET_TRACE_EVENTS & (TICKET_TRACE_EVENTS - 1)) == 0, "TICKET_TRACE_EVENTS must be a power of 2");
+
+ public:
+  static const size_t N = TICKET_TRACE_EVENTS;
+  struct Event {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> begin{0}, end{0};
+    std::atomic<long long> arg{-1};  // -1表示没有
+  };
+
+  int tid;
+  std::atomic<size_t> count{0};  // 一共记过多少条，只由所属线程写
+  Event events[N];
+
+  explicit TraceRing(int id)
+      : tid(id) {}
+
+  void Push(const char* name, uint64_t begin, uint64_t end, long long arg) {
+    size_t n = count.load(std::memory_order_relaxed);
+    Event& e = events[n & (N - 1)];
+    e.name.store(name, std::memory_order_relaxed);
+    e.begin.store(begin, std::memory_order_relaxed);
+    e.end.store(end, std::memory_order_relaxed);
+    e.arg.store(arg, std::memory_order_relaxed);
+    count.store(n + 1, std::memory_order_release);
+  }
+};
+
+// 所有线程的缓冲区，进程结束前不释放
+class TraceRegistry {
+ private:
+  std::mutex m;
+  vector<TraceRing*> rings;
+
+ public:
+  TraceRing* Add() {
+    std::lock_guard<std::mutex> lk(m);
+    TraceRing* r = new TraceRing(rings.size() + 1);
+    rings.push_back(r);
+    return r;
+  }
+  template <class F>
+  void ForEach(F fn) {
+    std::lock_guard<std::mutex> lk(m);
+    for (size_t i = 0; i < rings.size(); ++i)
+      fn(*rings[i]);
+  }
+};
+TraceRegistry traceRings;
+thread_local TraceRing* traceRing = nullptr;
+
+// 和stats.hpp的NowNanos同一个时钟；stats.hpp要包含这里，所以不反过来用它
+inline uint64_t TraceNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void TraceRecord(const char* name, uint64_t begin, uint64_t end, long long arg = -1) {
+  if (!traceRing)
+    traceRing = traceRings.Add();
+  traceRing->Push(name, begin, end, arg);
+}
+
+class TraceSpan {
+ private:
+  const char* name;
+  long long arg;
+  uint64_t begin;
+
+ public:
+  explicit TraceSpan(const char* name_, long long arg_ = -1)
+      : name(name_), arg(arg_), begin(TraceNow()) {}
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+  ~TraceSpan() {
+    TraceRecord(name, begin, TraceNow(), arg);
+  }
+};
+
+// 纳秒写成微秒，保留三位小数
+inline void TraceMicros(Writer& w, uint64_t ns) {
+  w << static_cast<long long>(ns / 1000) << '.';
+  int frac = ns % 1000;
+  w << static_cast<char>('0' + frac / 100);
+  w.put2(frac % 100);
+}
+
+// 把所有线程缓冲区里的记录写成一个JSON文件，返回写了几条，打不开文件返回-1
+inline long ExportTrace(const char* path) {
+  FILE* f = fopen(path, "w");
+  if (!f)
+    return -1;
+  Writer w(f);
+  long written = 0;
+  w << "{\"traceEvents\":[";
+  traceRings.ForEach([&](TraceRing& r) {
+    size_t n = r.count.load(std::memory_order_acquire);
+    size_t first = n > TraceRing::N ? n - TraceRing::N : 0;
+    for (size_t i = first; i < n; ++i) {
+      const TraceRing::Event& e = r.events[i & (TraceRing::N - 1)];
+      const char* name = e.name.load(std::memory_order_relaxed);
+      uint64_t begin = e.begin.load(std::memory_order_relaxed), end = e.end.load(std::memory_order_relaxed);
+      long long arg = e.arg.load(std::memory_order_relaxed);
+      if (!name || end < begin)
+        continue;
+      w << (written ? ",\n" : "\n") << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << r.tid << ",\"ts\":";
+      TraceMicros(w, begin);
+      w << ",\"dur\":";
+      TraceMicros(w, end - begin);
+      if (arg >= 0)
+        w << ",\"args\":{\"stamp\":" << arg << '}';
+      w << '}';
+      ++written;
+    }
+  });
+  w << "\n]}\n";
+  w.flush();
+  fclose(f);
+  return written;
+}
+
+}  // namespace sjtu
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(...) sjtu::TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(__VA_ARGS__)
+
+#else  // !TICKET_TRACE
+
+namespace sjtu {
+
+inline long ExportTrace(const char*) {
+  return -1;
+}
+
+}  // namespace sjtu
+
+#define TRACE_SPAN(...) ((void)0)
+
+#endif  // TICKET_TRACE
+
+namespace sjtu {
+
+// 退出时和trace_dump指令导出到这里，nullptr表示不导出
+const char* tracePath = nullptr;
+
+}  // namespace sjtu
+
+#endif  // !SJTU_TRACE_HPP
@@ -2,22 +2,34 @@
 #define SJTU_TICKET_UTILS_HPP
 
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include "arena.hpp"
 #include "map.hpp"
 #include "utility.hpp"
 #include "vector.hpp"
+#include "writer.hpp"
 
 using std::cin;
 using std::cout;
 using std::string;
+using std::string_view;
 
 namespace sjtu {
 
+// 把s拷进大小为cap的缓冲区，放不下的部分截掉，总是以'\0'结尾
+inline void CopyBounded(char* dst, size_t cap, string_view s) {
+  size_t n = s.size() < cap ? s.size() : cap - 1;
+  memcpy(dst, s.data(), n);
+  dst[n] = 0;
+}
+
 // 48长度string
 struct String {
   char str[48];
@@ -28,6 +40,9 @@ struct String {
   String(const char* s) {
     strcpy(str, s);
   }
+  String(string_view s) {
+    CopyBounded(str, sizeof(str), s);
+  }
   String(const String& s) {
     strcpy(str, s.str);
   }
@@ -45,6 +60,10 @@ struct String {
     strcpy(str, s.c_str());
     return *this;
   }
+  String& operator=(string_view s) {
+    CopyBounded(str, sizeof(str), s);
+    return *this;
+  }
   string toString() {
     return string(str);
   }
@@ -60,9 +79,8 @@ struct String {
   friend bool operator!=(const String& lhs, const String& rhs) {
     return !(lhs == rhs);
   }
-  friend std::ostream& operator<<(std::ostream& os, const String& s) {
-    os << s.str;
-    return os;
+  friend Writer& operator<<(Writer& os, const String& s) {
+    return os << s.str;
   }
 };
 
@@ -76,6 +94,9 @@ struct Word {
   Word(const char* s) {
     strcpy(str, s);
   }
+  Word(string_view s) {
+    CopyBounded(str, sizeof(str), s);
+  }
   Word(const Word& s) {
     strcpy(str, s.str);
   }
@@ -93,6 +114,10 @@ struct Word {
     strcpy(str, s.c_str());
     return *this;
   }
+  Word& operator=(string_view s) {
+    CopyBounded(str, sizeof(str), s);
+    return *this;
+  }
   string toString() {
     return string(str);
   }
@@ -108,9 +133,8 @@ struct Word {
   friend bool operator!=(const Word& lhs, const Word& rhs) {
     return !(lhs == rhs);
   }
-  friend std::ostream& operator<<(std::ostream& os, const Word& s) {
-    os << s.str;
-    return os;
+  friend Writer& operator<<(Writer& os, const Word& s) {
+    return os << s.str;
   }
 };
 
@@ -124,6 +148,9 @@ struct ID {
   ID(const char* s) {
     strcpy(str, s);
   }
+  ID(string_view s) {
+    CopyBounded(str, sizeof(str), s);
+  }
   ID(const ID& s) {
     strcpy(str, s.str);
   }
@@ -141,6 +168,10 @@ struct ID {
     strcpy(str, s.c_str());
     return *this;
   }
+  ID& operator=(string_view s) {
+    CopyBounded(str, sizeof(str), s);
+    return *this;
+  }
   string toString() {
     return string(str);
   }
@@ -156,27 +187,36 @@ struct ID {
   friend bool operator!=(const ID& lhs, const ID& rhs) {
     return !(lhs == rhs);
   }
-  friend std::ostream& operator<<(std::ostream& os, const ID& s) {
-    os << s.str;
-    return os;
+  friend Writer& operator<<(Writer& os, const ID& s) {
+    return os << s.str;
   }
 };
 
-// 字符串分割函数
-void SplitString(vector<std::string>& v, const string& s, char delim = '|') {
+// 字符串分割函数，切出来的都是s上的视图，不复制
+void SplitString(vector<string_view>& v, string_view s, char delim = '|') {
   v.clear();
-  string token;
   size_t start = 0;
   size_t end = s.find(delim);
 
-  while (end != std::string::npos) {
-    token = s.substr(start, end - start);
-    v.push_back(token);
+  while (end != string_view::npos) {
+    v.push_back(s.substr(start, end - start));
     start = end + 1;
     end = s.find(delim, start);
   }
 
-  v.push_back(s.substr(start, end));
+  v.push_back(s.substr(start));
+}
+
+// 不分配内存的整数解析，代替stoi(substr)
+int ParseInt(string_view s) {
+  int ret = 0;
+  size_t i = 0;
+  bool neg = false;
+  if (i < s.size() && s[i] == '-')
+    neg = true, ++i;
+  for (; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i)
+    ret = ret * 10 + (s[i] - '0');
+  return neg ? -ret : ret;
 }
 
 template <class T>
@@ -207,6 +247,117 @@ void Sort(vector<T>& v, bool (*comp)(const T&, const T&) = std::less<T>()) {
   delete[] a;
 }
 
+// v[0, n)上的大根堆（comp意义下最大的在堆顶），把v[i]往下沉
+template <class T, class A>
+void SiftDown(vector<T, A>& v, int i, int n, bool (*comp)(const T&, const T&)) {
+  while (true) {
+    int c = i * 2 + 1;
+    if (c >= n)
+      return;
+    if (c + 1 < n && comp(v[c], v[c + 1]))
+      ++c;
+    if (!comp(v[i], v[c]))
+      return;
+    std::swap(v[i], v[c]);
+    i = c;
+  }
+}
+// v[0, n)已经是堆，逐个取出堆顶，排成升序
+template <class T, class A>
+void PopHeap(vector<T, A>& v, int n, bool (*comp)(const T&, const T&)) {
+  for (int e = n - 1; e > 0; --e) {
+    std::swap(v[0], v[e]);
+    SiftDown(v, 0, e, comp);
+  }
+}
+/*
+前k小
+* 前k个位置当作大根堆，后面的比堆顶小就替换堆顶，最后把堆排好序
+* O(n log k)，原地，不分配内存；k不小于元素个数时就是整个数组的堆排序
+* 堆排序不稳定，比较的键要互不相同
+return: 排好的个数，即min(k, v.size())，v里在它之后的元素是丢掉的那些，顺序任意
+*/
+template <class T, class A>
+int TopK(vector<T, A>& v, int k, bool (*comp)(const T&, const T&)) {
+  int n = v.size();
+  if (k > n)
+    k = n;
+  if (k <= 0)
+    return 0;
+  for (int i = k / 2 - 1; i >= 0; --i)
+    SiftDown(v, i, k, comp);
+  for (int i = k; i < n; ++i) {
+    if (comp(v[i], v[0])) {
+      std::swap(v[0], v[i]);
+      SiftDown(v, 0, k, comp);
+    }
+  }
+  PopHeap(v, k, comp);
+  return k;
+}
+
+// 每个线程一块反复使用的临时数组，只增不减
+template <class T>
+class Scratch {
+ private:
+  T* p = nullptr;
+  size_t cap = 0;
+
+ public:
+  Scratch() = default;
+  Scratch(const Scratch&) = delete;
+  Scratch& operator=(const Scratch&) = delete;
+  ~Scratch() {
+    delete[] p;
+  }
+  T* Get(size_t n) {
+    if (n > cap) {
+      delete[] p;
+      cap = std::max(n, cap * 2);
+      p = new T[cap];
+    }
+    return p;
+  }
+};
+
+// 基数排序的元素：64位键 + 原来的下标
+struct RadixItem {
+  uint64_t key;
+  int idx;
+};
+/*
+按key的LSD基数排序，一趟8位，稳定
+* 先扫一遍把8个字节的分布都数出来，所有元素在某个字节上都相同的那一趟直接跳过
+* tmp是和a一样大的临时空间，结果在a里
+*/
+inline void RadixSort(RadixItem* a, RadixItem* tmp, int n) {
+  if (n < 2)
+    return;
+  unsigned count[8][256];
+  memset(count, 0, sizeof(count));
+  for (int i = 0; i < n; ++i)
+    for (int b = 0; b < 8; ++b)
+      ++count[b][(a[i].key >> (b * 8)) & 255];
+  RadixItem* src = a;
+  RadixItem* dst = tmp;
+  for (int b = 0; b < 8; ++b) {
+    unsigned* c = count[b];
+    if (c[(a[0].key >> (b * 8)) & 255] == static_cast<unsigned>(n))
+      continue;
+    unsigned sum = 0;
+    for (int d = 0; d < 256; ++d) {
+      unsigned t = c[d];
+      c[d] = sum;
+      sum += t;
+    }
+    for (int i = 0; i < n; ++i)
+      dst[c[(src[i].key >> (b * 8)) & 255]++] = src[i];
+    std::swap(src, dst);
+  }
+  if (src != a)
+    memcpy(a, src, n * sizeof(RadixItem));
+}
+
 }  // namespace sjtu
 
 #endif  // !SJTU_TICKETS_UTILS_HPP
@@ -0,0 +1,158 @@
+#ifndef SJTU_WIRE_HPP
+#define SJTU_WIRE_HPP
+
+#include <cstdint>
+
+#include "Calendar.hpp"
+#include "writer.hpp"
+
+namespace sjtu {
+
+/*
+二进制协议的基本编码
+* 一帧：1字节magic + 1字节指令类型 + 4字节负载长度 + 负载
+* 请求帧magic是RequestMagic，回复帧是ReplyMagic；文本协议的行总以'['开头，不会和magic撞上
+* 负载第一个字段都是4字节时间戳
+* 整数定长小端；短字符串1字节长度+内容，长字符串2字节长度+内容
+  长度放不下时只写前MaxStr/MaxLongStr个字节，长度和内容对得上，后面的帧不会错位；
+  截断后仍然超出字段上限的由解码端当坏帧
+* 日期打包成2字节 (月<<8)|日，日期时间打包成4字节 (月<<24)|(日<<16)|当天分钟数
+*/
+const unsigned char RequestMagic = 0xB7;
+const unsigned char ReplyMagic = 0xB8;
+const size_t FrameHeader = 6;
+const size_t MaxFrame = 1 << 20;     // 负载长度上限，超过就当坏帧
+const uint32_t NoDateTime = 0xFFFFFFFFu;  // xx-xx xx:xx
+const size_t MaxStr = 0xFF, MaxLongStr = 0xFFFF;  // 短/长字符串最多的字节数
+
+inline void Put8(Writer& w, unsigned v) {
+  w << static_cast<char>(v);
+}
+inline void Put16(Writer& w, unsigned v) {
+  char* p = w.reserve(2);
+  p[0] = static_cast<char>(v), p[1] = static_cast<char>(v >> 8);
+  w.commit(2);
+}
+inline void Put32(Writer& w, uint32_t v) {
+  char* p = w.reserve(4);
+  for (int i = 0; i < 4; ++i)
+    p[i] = static_cast<char>(v >> (i * 8));
+  w.commit(4);
+}
+inline void Put64(Writer& w, uint64_t v) {
+  Put32(w, static_cast<uint32_t>(v));
+  Put32(w, static_cast<uint32_t>(v >> 32));
+}
+inline void PutStr(Writer& w, string_view s) {
+  s = s.substr(0, MaxStr);
+  Put8(w, s.size());
+  w.write(s.data(), s.size());
+}
+inline void PutLongStr(Writer& w, string_view s) {
+  s = s.substr(0, MaxLongStr);
+  Put16(w, s.size());
+  w.write(s.data(), s.size());
+}
+inline void Patch32(char* p, uint32_t v) {
+  for (int i = 0; i < 4; ++i)
+    p[i] = static_cast<char>(v >> (i * 8));
+}
+
+inline unsigned PackDate(const Date& d) {
+  return d.month << 8 | d.date;
+}
+inline uint32_t PackDateTime(const DateTime& dt) {
+  return static_cast<uint32_t>(dt.date.month) << 24 | dt.date.date << 16 | (dt.time.hour * 60 + dt.time.minute);
+}
+inline DateTime UnpackDateTime(uint32_t v) {
+  unsigned minutes = v & 0xFFFF;
+  return DateTime(v >> 24, (v >> 16) & 0xFF, minutes / 60, minutes % 60);
+}
+
+/*
+按顺序读一段负载
+* 越界时ok置false，之后读到的都是0/空串，调用者最后检查一次ok就行
+*/
+class WireReader {
+ private:
+  const unsigned char* p;
+  const unsigned char* end;
+
+  bool Need(size_t n) {
+    if (static_cast<size_t>(end - p) < n)
+      ok = false;
+    return ok;
+  }
+
+ public:
+  bool ok = true;
+
+  WireReader(const char* data, size_t n)
+      : p(reinterpret_cast<const unsigned char*>(data)), end(p + n) {}
+
+  unsigned Get8() {
+    return Need(1) ? *p++ : 0;
+  }
+  unsigned Get16() {
+    if (!Need(2))
+      return 0;
+    unsigned v = p[0] | p[1] << 8;
+    p += 2;
+    return v;
+  }
+  uint32_t Get32() {
+    if (!Need(4))
+      return 0;
+    uint32_t v = p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+    p += 4;
+    return v;
+  }
+  uint64_t Get64() {
+    uint64_t lo = Get32();
+    return lo | static_cast<uint64_t>(Get32()) << 32;
+  }
+  int GetInt() {
+    return static_cast<int>(Get32());
+  }
+  string_view GetStr() {
+    return Take(Get8());
+  }
+  // 要放进大小为cap（含结尾'\0'）的定长字段，放不下就算坏帧
+  string_view GetStr(size_t cap) {
+    string_view s = GetStr();
+    if (s.size() >= cap)
+      ok = false;
+    return s;
+  }
+  string_view GetLongStr() {
+    return Take(Get16());
+  }
+  string_view Take(size_t n) {
+    if (!Need(n))
+      return string_view();
+    string_view s(reinterpret_cast<const char*>(p), n);
+    p += n;
+    return s;
+  }
+  // 月份和日都在合法范围里才算数
+  Date GetDate() {
+    unsigned v = Get16();
+    int m = v >> 8, d = v & 0xFF;
+    if (m < 1 || m > 12 || d < 1 || d > MonthDays[m])
+      ok = false;
+    return ok ? Date(m, d) : Date();
+  }
+  bool Done() const {
+    return ok && p == end;
+  }
+};
+
+// 帧头里的负载长度
+inline uint32_t FrameLength(const char* frame) {
+  WireReader r(frame + 2, 4);
+  return r.Get32();
+}
+
+}  // namespace sjtu
+
+#endif  // !SJTU_WIRE_HPP
@@ -0,0 +1,146 @@
+#ifndef SJTU_WRITER_HPP
+#define SJTU_WRITER_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace sjtu {
+
+// 00~99 的两位数表，日期时间和整数输出都靠它，避免逐位 / 10 % 10
+const char Digits2[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/*
+带缓冲的输出器
+* 所有系统的输出都先写进这里，每条指令结束后由main统一flush一次
+* 缓冲区按需倍增，一条指令的输出再大也不会中途写出
+*/
+class Writer {
+ private:
+  char* buf;
+  size_t len = 0;
+  size_t cap;
+  FILE* sink;
+
+  void grow(size_t need) {
+    while (cap < len + need)
+      cap <<= 1;
+    buf = static_cast<char*>(realloc(buf, cap));
+  }
+
+ public:
+  explicit Writer(FILE* f = stdout, size_t c = 1 << 16)
+      : cap(c), sink(f) {
+    buf = static_cast<char*>(malloc(cap));
+  }
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+  ~Writer() {
+    flush();
+    free(buf);
+  }
+
+  // 保证还能再写n个字节，返回写入位置，配合commit使用
+  char* reserve(size_t n) {
+    if (len + n > cap)
+      grow(n);
+    return buf + len;
+  }
+  void commit(size_t n) {
+    len += n;
+  }
+
+  void write(const char* s, size_t n) {
+    memcpy(reserve(n), s, n);
+    len += n;
+  }
+  // 写一个 [0,99] 的数，固定两位
+  void put2(int x) {
+    char* p = reserve(2);
+    p[0] = Digits2[x * 2];
+    p[1] = Digits2[x * 2 + 1];
+    len += 2;
+  }
+
+  Writer& operator<<(char c) {
+    *reserve(1) = c;
+    ++len;
+    return *this;
+  }
+  Writer& operator<<(const char* s) {
+    write(s, strlen(s));
+    return *this;
+  }
+  Writer& operator<<(std::string_view s) {
+    write(s.data(), s.size());
+    return *this;
+  }
+  Writer& operator<<(long long x) {
+    char tmp[24];
+    char* p = tmp + sizeof(tmp);
+    unsigned long long u = x < 0 ? 0ULL - static_cast<unsigned long long>(x) : x;
+    // 两位两位地从后往前填
+    while (u >= 100) {
+      int r = u % 100;
+      u /= 100;
+      *--p = Digits2[r * 2 + 1];
+      *--p = Digits2[r * 2];
+    }
+    if (u >= 10) {
+      *--p = Digits2[u * 2 + 1];
+      *--p = Digits2[u * 2];
+    } else
+      *--p = '0' + u;
+    if (x < 0)
+      *--p = '-';
+    write(p, tmp + sizeof(tmp) - p);
+    return *this;
+  }
+  Writer& operator<<(int x) {
+    return *this << static_cast<long long>(x);
+  }
+  Writer& operator<<(size_t x) {
+    return *this << static_cast<long long>(x);
+  }
+
+  const char* data() const {
+    return buf;
+  }
+  // 回填已经写过的字节用
+  char* data() {
+    return buf;
+  }
+  size_t size() const {
+    return len;
+  }
+  void clear() {
+    len = 0;
+  }
+  // 只交换缓冲区，sink不动；流水线里用来把一批输出交给写线程
+  void swap(Writer& other) {
+    std::swap(buf, other.buf);
+    std::swap(len, other.len);
+    std::swap(cap, other.cap);
+  }
+  // 交给sink，一条指令调用一次
+  void flush() {
+    if (len && sink)
+      fwrite(buf, 1, len, sink);
+    len = 0;
+  }
+};
+
+// 输出器，替代cout；每个线程一个，并发执行的查询各写各的
+thread_local Writer wout;
+
+}  // namespace sjtu
+
+#endif  // !SJTU_WRITER_HPP